@@ -0,0 +1,91 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/bank.h>
+#include <elevator/test.h>
+
+#include <iterator>
+
+namespace elevator {
+
+Bank::Car::Car( int id, HeartBeat &heartbeat, ConcurrentQueue< StateChange > &stateOut,
+        QueueBackend backend, Elevator::PollRate pollRate, const std::string &device ) :
+    commands( backend ),
+    elevator( id, heartbeat, commands, stateOut, pollRate, device.c_str() ),
+    delivered( 0 )
+{ }
+
+void Bank::Car::deliver( const Command &command ) {
+    // counted before it can be handled
+    delivered.fetch_add( 1, std::memory_order_release );
+    commands.enqueue( command );
+}
+
+void Bank::Car::deliver( const std::vector< Command > &batch ) {
+    delivered.fetch_add( batch.size(), std::memory_order_release );
+    commands.enqueueBatch( batch.begin(), batch.end() );
+}
+
+Bank::Bank( int firstId, int cars, HeartBeatManager &heartbeats,
+        ConcurrentQueue< StateChange > &stateOut, QueueBackend commandBackend,
+        Elevator::PollRate pollRate ) :
+    _firstId( firstId )
+{
+    assert_lt( 0, cars, "bank needs at least one car" );
+    _batch.reserve( _batchSize );
+    for ( int i = 0; i < cars; ++i )
+        _cars.emplace_back( new Car( firstId + i, heartbeats.getNew( 500 /* ms */ ),
+                    stateOut, commandBackend, pollRate, deviceName( i ) ) );
+}
+
+Bank::~Bank() {
+    terminate();
+}
+
+std::string Bank::deviceName( int i ) {
+    return "/dev/comedi" + std::to_string( i );
+}
+
+void Bank::deliver( const Command &command ) {
+    if ( command.targetElevatorId == Command::ANY_ID ) {
+        for ( auto &car : _cars )
+            car->deliver( command );
+    } else if ( has( command.targetElevatorId ) )
+        _car( command.targetElevatorId ).deliver( command );
+}
+
+void Bank::deliver( const std::vector< Command > &batch ) {
+    std::vector< Command > own;
+    for ( int i = 0; i < size() && !batch.empty(); ++i ) {
+        own.clear();
+        for ( const auto &command : batch )
+            if ( command.targetElevatorId == Command::ANY_ID
+                    || command.targetElevatorId == _firstId + i )
+                own.push_back( command );
+        if ( !own.empty() )
+            _cars[ i ]->deliver( own );
+    }
+}
+
+void Bank::attach( Poller &poller, ConcurrentQueue< Command > &queue ) {
+    poller.add( queue.enableNotifyFd(), [this, &queue]() {
+            queue.acknowledgeNotify();
+            do {
+                _batch.clear();
+                queue.dequeueBatch( std::back_inserter( _batch ), _batchSize );
+                deliver( _batch );
+            } while ( !_batch.empty() );
+        } );
+}
+
+void Bank::run() {
+    for ( auto &car : _cars )
+        car->elevator.run();
+}
+
+void Bank::terminate() {
+    for ( auto &car : _cars )
+        if ( car->elevator.running() )
+            car->elevator.terminate();
+}
+
+}
@@ -0,0 +1,99 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Bank of elevator cars controlled from single process
+ *
+ * Each car has its own control loop (Elevator), hardware device and command
+ * queue, cars have consecutive ids starting from firstId. All cars report
+ * state changes to one queue processed by single Scheduler, commands are
+ * delivered to cars directly in process (no loopback networking). Commands
+ * for this bank which arrive from network can be routed to cars by poller
+ * thread (see attach).
+ */
+
+#include <elevator/elevator.h>
+#include <elevator/concurrentqueue.h>
+#include <elevator/heartbeat.h>
+#include <elevator/poller.h>
+#include <elevator/command.h>
+#include <elevator/state.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifndef SRC_BANK_H
+#define SRC_BANK_H
+
+namespace elevator {
+
+struct Bank {
+    /* commandBackend must be multi-producer if commands are delivered from
+     * more than one thread (e.g. scheduler and network poller) */
+    Bank( int firstId, int cars, HeartBeatManager &, ConcurrentQueue< StateChange > &stateOut,
+            QueueBackend commandBackend = QueueBackend::Locked,
+            Elevator::PollRate = Elevator::PollRate() );
+    Bank( const Bank & ) = delete;
+    ~Bank();
+
+    int size() const { return _cars.size(); }
+    int firstId() const { return _firstId; }
+    bool has( int id ) const { return id >= _firstId && id < _firstId + size(); }
+
+    Elevator &car( int id ) { return _car( id ).elevator; }
+    ConcurrentQueue< Command > &commands( int id ) { return _car( id ).commands; }
+
+    /** floors (same for all cars) */
+    BasicDriverInfo info() const { return _cars.front()->elevator.info(); }
+
+    /** deliver command to its target car, Command::ANY_ID goes to all cars,
+     * commands for cars not in bank are ignored */
+    void deliver( const Command & );
+
+    /** deliver commands in order, commands for one car are enqueued at once
+     * so that car handles them in single cycle if it is not handling
+     * commands already */
+    void deliver( const std::vector< Command > & );
+
+    /** number of commands delivered to car so far (compare with
+     * Elevator::handledCommands) */
+    long delivered( int id ) { return _car( id ).delivered.load( std::memory_order_acquire ); }
+
+    /** deliver commands from given queue in poller thread, must be called
+     * before anything is enqueued into queue */
+    void attach( Poller &, ConcurrentQueue< Command > & );
+
+    /* spawn control loops of all cars (non blocking) */
+    void run();
+    void terminate();
+
+    /** hardware device of i-th car of bank */
+    static std::string deviceName( int i );
+
+  private:
+    struct Car {
+        Car( int id, HeartBeat &, ConcurrentQueue< StateChange > &, QueueBackend,
+                Elevator::PollRate, const std::string &device );
+        ConcurrentQueue< Command > commands;
+        Elevator elevator;
+        std::atomic< long > delivered;
+
+        void deliver( const Command & );
+        void deliver( const std::vector< Command > & );
+    };
+
+    const int _firstId;
+    std::vector< std::unique_ptr< Car > > _cars;
+    std::vector< Command > _batch; // used by poller thread only
+
+    Car &_car( int id ) {
+        assert( has( id ), "car not in bank" );
+        return *_cars[ id - _firstId ];
+    }
+
+    static const size_t _batchSize = 64;
+};
+
+}
+
+#endif // SRC_BANK_H
@@ -0,0 +1,238 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/bank.h>
+#include <elevator/scheduler.h>
+#include <elevator/simulator.h>
+#include <elevator/channels.h>
+#include <elevator/test.h>
+#include <thread>
+#include <chrono>
+
+using namespace elevator;
+
+struct TestBank {
+
+    static void _resetDevices( int cars ) {
+        lowlevel::Simulator::Config config;
+        config.timeScale = 10;
+        config.floorTime = 1;
+        config.pressTime = 2; // so that it is not missed by idle polling
+        for ( int i = 0; i < cars; ++i )
+            lowlevel::Simulator::device( Bank::deviceName( i ) ).reset( config );
+    }
+
+    Test deliver() {
+        _resetDevices( 2 );
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > states;
+        Bank bank{ 3, 2, hbm, states };
+        assert( bank.has( 3 ) && bank.has( 4 ), "ids" );
+        assert( !bank.has( 2 ) && !bank.has( 5 ), "ids" );
+
+        Command comm;
+        bank.deliver( Command{ CommandType::TurnOnLightUp, 4, 2 } );
+        assert( !bank.commands( 3 ).tryDequeue( comm ), "not for 3" );
+        assert( bank.commands( 4 ).tryDequeue( comm ), "for 4" );
+        assert_eq( comm.targetFloor, 2, "command" );
+
+        bank.deliver( Command{ CommandType::TurnOnLightUp, Command::ANY_ID, 2 } );
+        assert( bank.commands( 3 ).tryDequeue( comm ), "any" );
+        assert( bank.commands( 4 ).tryDequeue( comm ), "any" );
+
+        bank.deliver( Command{ CommandType::TurnOnLightUp, 7, 2 } );
+        assert( !bank.commands( 3 ).tryDequeue( comm ), "other bank" );
+        assert( !bank.commands( 4 ).tryDequeue( comm ), "other bank" );
+    }
+
+    Test serve() {
+        const int cars = 3;
+        _resetDevices( cars );
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > stateIn, stateOut;
+        ConcurrentQueue< Command > remote;
+        Bank bank{ 0, cars, hbm, stateIn };
+        Scheduler scheduler{ hbm.getNew( 1000 ), bank, stateIn, stateOut, remote };
+        bank.run();
+        scheduler.run();
+
+        // hall call from panel of second car can be served by any car
+        lowlevel::Simulator::device( Bank::deviceName( 1 ) ).pressButton( FLOOR_UP3 );
+        int served = -1;
+        for ( int i = 0; i < 1000 && served < 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            for ( int c = 0; c < cars; ++c ) {
+                auto &sim = lowlevel::Simulator::device( Bank::deviceName( c ) );
+                if ( sim.output( DOOR_OPEN ) && sim.sensorFloor() == 2 )
+                    served = c;
+            }
+        }
+        assert_leq( 0, served, "call served" );
+        bank.terminate();
+        assert( !stateOut.tryDequeue().isNothing(), "local state propagated" );
+        _resetDevices( cars );
+    }
+
+    Test destination() {
+        const int cars = 2;
+        _resetDevices( cars );
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > stateIn, stateOut;
+        ConcurrentQueue< Command > remote;
+        Bank bank{ 0, cars, hbm, stateIn };
+        Scheduler scheduler{ hbm.getNew( 1000 ), bank, stateIn, stateOut, remote };
+        bank.run();
+        scheduler.run();
+
+        // passenger from floor 3 to floor 1: picked up and then delivered
+        // by the same car without pressing inside button
+        scheduler.registerDestination( DestinationCall{ 3, 1 } );
+        int picked = -1, delivered = -1;
+        for ( int i = 0; i < 2000 && delivered < 0; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            for ( int c = 0; c < cars; ++c ) {
+                auto &sim = lowlevel::Simulator::device( Bank::deviceName( c ) );
+                if ( !sim.output( DOOR_OPEN ) )
+                    continue;
+                if ( picked < 0 && sim.sensorFloor() == 2 )
+                    picked = c;
+                if ( picked == c && sim.sensorFloor() == 0 )
+                    delivered = c;
+            }
+        }
+        assert_leq( 0, picked, "passenger picked up" );
+        assert_eq( picked, delivered, "passenger delivered" );
+        bank.terminate();
+        _resetDevices( cars );
+    }
+
+    Test destinationDoorOpen() {
+        _resetDevices( 1 );
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > states;
+        Bank bank{ 0, 1, hbm, states };
+        bank.run();
+
+        auto &sim = lowlevel::Simulator::device( Bank::deviceName( 0 ) );
+        auto await = [&]( int sensor ) {
+            for ( int i = 0; i < 2000; ++i ) {
+                if ( sim.output( DOOR_OPEN ) && sim.sensorFloor() == sensor )
+                    return true;
+                std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+            }
+            return false;
+        };
+        bank.deliver( Command{ CommandType::CallToFloorAndGoUp, 0, 2 } );
+        assert( await( 1 ), "car arrived at floor 2" );
+
+        // passengers assigned to car which already waits at their floor
+        // with open door, one goes up and one down
+        bank.deliver( Command{ CommandType::DestinationCall, 0, 2, 4 } );
+        bank.deliver( Command{ CommandType::DestinationCall, 0, 2, 1 } );
+        assert( await( 3 ), "passenger going up delivered" );
+        // the other one waits for car to come back, it does not ride up
+        assert( await( 1 ), "car returned for passenger going down" );
+        assert( await( 0 ), "passenger going down delivered" );
+        bank.terminate();
+        _resetDevices( 1 );
+    }
+
+    Test park() {
+        _resetDevices( 1 );
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > states;
+        Bank bank{ 0, 1, hbm, states };
+        bank.run();
+
+        auto &sim = lowlevel::Simulator::device( Bank::deviceName( 0 ) );
+        bank.deliver( Command{ CommandType::ParkAt, 0, 3 } );
+        bool parked = false;
+        for ( int i = 0; i < 1000 && !parked; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+            parked = sim.sensorFloor() == 2 && sim.velocity() == 0;
+        }
+        assert( parked, "car parked" );
+        bank.terminate();
+        _resetDevices( 1 );
+    }
+
+    Test parkCancelledByCall() {
+        _resetDevices( 1 );
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > states;
+        Bank bank{ 0, 1, hbm, states };
+        bank.run();
+
+        auto &sim = lowlevel::Simulator::device( Bank::deviceName( 0 ) );
+        bank.deliver( Command{ CommandType::ParkAt, 0, 4 } );
+        bool moving = false;
+        for ( int i = 0; i < 2000 && !moving; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            moving = sim.sensorFloor() == 1 && sim.velocity() > 0;
+        }
+        assert( moving, "car is on its way to park floor" );
+
+        // call behind car cancels parking, car turns without going to park floor
+        bank.deliver( Command{ CommandType::CallToFloorAndGoUp, 0, 1 } );
+        bool served = false, parked = false;
+        for ( int i = 0; i < 2000 && !served; ++i ) {
+            std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+            served = sim.output( DOOR_OPEN ) && sim.sensorFloor() == 0;
+            parked = parked || sim.sensorFloor() == 3;
+        }
+        assert( served, "call served" );
+        assert( !parked, "car did not continue to park floor" );
+        bank.terminate();
+        _resetDevices( 1 );
+    }
+
+    Test parkHotFloor() {
+        _resetDevices( 1 );
+        ManualClock clock;
+        clock.setTimeOfDay( 8 * 3600 * 1000 );
+        ScopedClock scope{ clock };
+        // waiting threads need running clock to finish (stopped after them)
+        struct Ticker {
+            explicit Ticker( ManualClock &clock ) : stop( false ), thread( [this, &clock] {
+                    while ( !stop ) {
+                        clock.advance( 10 );
+                        std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+                    }
+                } )
+            { }
+            ~Ticker() { stop = true; thread.join(); }
+            std::atomic< bool > stop;
+            std::thread thread;
+        } ticker{ clock };
+
+        HeartBeatManager hbm;
+        ConcurrentQueue< StateChange > stateIn, stateOut;
+        ConcurrentQueue< Command > remote;
+        Bank bank{ 0, 1, hbm, stateIn }; // car is not running, commands stay queued
+        Scheduler scheduler{ hbm.getNew( 1000 ), bank, stateIn, stateOut, remote };
+
+        auto change = []( int id, ChangeType type, int floor ) {
+            StateChange c;
+            c.changeType = type;
+            c.changeFloor = floor;
+            c.state.id = id;
+            c.state.lastFloor = 1;
+            c.state.doorOpen = false;
+            return c;
+        };
+        // idle local car in lobby, morning calls at floor 4 come from other bank
+        stateIn.enqueue( change( 0, ChangeType::OtherChange, 1 ) );
+        for ( int i = 0; i < 3; ++i )
+            stateIn.enqueue( change( 1, ChangeType::ButtonUpPressed, 4 ) );
+        scheduler.run();
+
+        int parkedAt = INT_MIN;
+        Command comm;
+        for ( int i = 0; i < 5000 && parkedAt == INT_MIN; ++i ) {
+            if ( !bank.commands( 0 ).tryDequeue( comm ) )
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            else if ( comm.commandType == CommandType::ParkAt )
+                parkedAt = comm.targetFloor;
+        }
+        assert_eq( parkedAt, 4, "idle car parked at hot floor" );
+    }
+};
@@ -15,6 +15,17 @@ enum class CommandType {
     TurnOffLightUp,
     TurnOnLightDown,
     TurnOffLightDown,
+
+    // call was reassigned to other elevator, lamp is kept
+    CancelCallUp,
+    CancelCallDown,
+
+    // destination dispatch: pick up passenger at targetFloor, then go to
+    // destinationFloor
+    DestinationCall,
+
+    // idle elevator should move to targetFloor and wait there
+    ParkAt,
 };
 
 struct Command {
@@ -24,23 +35,27 @@ struct Command {
     CommandType commandType;
     int targetElevatorId;
     int targetFloor;
+    int destinationFloor; // DestinationCall only
 
     Command() :
-        commandType( CommandType::Empty ), targetElevatorId( NO_ID ), targetFloor( NO_ID )
+        commandType( CommandType::Empty ), targetElevatorId( NO_ID ), targetFloor( NO_ID ),
+        destinationFloor( NO_ID )
     { }
-    Command( CommandType type, int targetElevId, int floor ) :
-        commandType( type ), targetElevatorId( targetElevId ), targetFloor( floor )
+    Command( CommandType type, int targetElevId, int floor, int destination = NO_ID ) :
+        commandType( type ), targetElevatorId( targetElevId ), targetFloor( floor ),
+        destinationFloor( destination )
     { }
 
     // serialization
-    explicit Command( std::tuple< CommandType, int, int > tuple ) :
-        Command( std::get< 0 >( tuple ), std::get< 1 >( tuple ), std::get< 2 >( tuple ) )
+    explicit Command( std::tuple< CommandType, int, int, int > tuple ) :
+        Command( std::get< 0 >( tuple ), std::get< 1 >( tuple ), std::get< 2 >( tuple ),
+                std::get< 3 >( tuple ) )
     { }
     static serialization::TypeSignature type() {
         return serialization::TypeSignature::ElevatorCommand;
     }
-    std::tuple< CommandType, int, int > tuple() const {
-        return std::make_tuple( commandType, targetElevatorId, targetFloor );
+    std::tuple< CommandType, int, int, int > tuple() const {
+        return std::make_tuple( commandType, targetElevatorId, targetFloor, destinationFloor );
     }
 };
 
@@ -2,10 +2,20 @@
 
 #include <mutex>
 #include <deque>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <atomic>
+#include <functional>
 #include <condition_variable>
 
-#include <elevator/time.h>
 #include <wibble/maybe.h>
+#include <elevator/time.h>
+#include <elevator/futex.h>
+#include <elevator/eventfd.h>
+#include <elevator/internal/ringbuffer.h>
+#include <elevator/test.h> // after wibble, to override assert
 
 #ifndef SRC_CONCURRENT_QUEUE_H
 #define SRC_CONCURRENT_QUEUE_H
@@ -13,80 +23,473 @@
 namespace elevator {
 
 /* Concurrent queue
- * so far just make sure it is consisten, no performance optimizations
- * but interface should be general enought to replace queue with faster one
+ * backend is selected per instance:
+ * - Locked: std::deque guarded by mutex, blocking with condition variable,
+ *   unbounded by default
+ * - LockFree: bounded multi-producer/multi-consumer ring, non-blocking
+ *   operations never take lock, blocking operations spin on ring and park on
+ *   futex only if ring is empty (or full for enqueue)
+ * - SPSC: bounded single-producer/single-consumer ring with wait-free push
+ *   and pop, usable only if there is exactly one thread which enqueues and
+ *   one which dequeues, blocking is handled the same way as in LockFree
+ *
+ * Bounded queues have overflow policy which decides what happens if element
+ * is enqueued into full queue:
+ * - Block: wait until there is space (default)
+ * - DropNewest: discard the element being enqueued
+ * - DropOldest: discard head of queue to make space (Locked and LockFree only)
+ * - Coalesce: (Locked only) elements with coalescing key (as given by key
+ *   function) carry only latest value for that key, on every enqueue queued
+ *   element with the same key is removed (new element is appended to the
+ *   end as usual); if queue is full, oldest element with key is dropped, if
+ *   there is none incoming element is dropped if it has key, otherwise
+ *   enqueue blocks -- elements without key are never dropped. To keep
+ *   enqueue cheap, only _coalesceWindow newest elements are searched for
+ *   the same key and only as many oldest elements for element to drop.
+ * Number of dropped and coalesced elements is counted.
+ *
+ * Optionally, queue can provide pollable file descriptor (eventfd) which is
+ * readable whenever queue may be non-empty, so that consumer can wait for
+ * several queues and sockets at once (see Poller).
+ *
+ * Elements are moved in and out of queue whenever possible, move-only types
+ * can be used with all operations except for those returning wibble::Maybe
+ * (use out-parameter versions instead). Ring backends require T to be
+ * default constructible.
  */
 
+enum class QueueBackend { Locked, LockFree, SPSC };
+enum class OverflowPolicy { Block, DropNewest, DropOldest, Coalesce };
+
 template< typename T >
 struct ConcurrentQueue {
 
-    void enqueue( const T &data ) {
-        Guard g{ _lock };
-        _queue.push_back( data );
-        _cond.notify_one();
+    static const size_t defaultCapacity = 1024;
+    static const size_t unbounded = 0; // Locked backend only
+
+    /* coalescing key of element, or noKey if element must not be coalesced
+     * nor dropped */
+    using CoalesceKey = std::function< long( const T & ) >;
+    static const long noKey = -1;
+
+    /** unbounded locked queue */
+    ConcurrentQueue() : ConcurrentQueue( QueueBackend::Locked, unbounded ) { }
+
+    /** capacity of ring backends is rounded up to power of 2 */
+    explicit ConcurrentQueue( QueueBackend backend, size_t capacity = defaultCapacity,
+            OverflowPolicy policy = OverflowPolicy::Block,
+            CoalesceKey key = CoalesceKey() ) :
+        _capacity( capacity ), _policy( policy ), _key( key ),
+        _dropped( 0 ), _coalesced( 0 ), _notifyPending( false ),
+        _backend( backend ),
+        _mpmc( backend == QueueBackend::LockFree
+                ? new _internal::MPMCRing< T >( capacity ) : nullptr ),
+        _spsc( backend == QueueBackend::SPSC
+                ? new _internal::SPSCRing< T >( capacity ) : nullptr )
+    {
+        assert( _ring() || policy == OverflowPolicy::Block || capacity != unbounded,
+                "overflow policy needs bounded queue" );
+        assert( policy != OverflowPolicy::Coalesce
+                || ( backend == QueueBackend::Locked && key && capacity != unbounded ),
+                "coalescing needs bounded Locked backend and key function" );
+        assert( policy != OverflowPolicy::DropOldest || backend != QueueBackend::SPSC,
+                "SPSC queue producer cannot drop oldest element" );
+    }
+
+    ConcurrentQueue( const ConcurrentQueue & ) = delete;
+
+    QueueBackend backend() const { return _backend; }
+    OverflowPolicy policy() const { return _policy; }
+
+    /** number of elements discarded because of overflow */
+    size_t dropped() const { return _dropped.load( std::memory_order_relaxed ); }
+    /** number of elements which were replaced by newer ones */
+    size_t coalesced() const { return _coalesced.load( std::memory_order_relaxed ); }
+
+    /** create pollable descriptor which is readable whenever queue may be
+     * non-empty, must be called before queue is shared between threads;
+     * once descriptor becomes readable, consumer must call acknowledgeNotify
+     * and then dequeue until queue is empty (e.g. with dequeueBatch)
+     */
+    int enableNotifyFd() {
+        if ( !_notifyFd )
+            _notifyFd.reset( new EventFd() );
+        return _notifyFd->fd();
+    }
+
+    /** -1 if notification descriptor is not enabled */
+    int notifyFd() const { return _notifyFd ? _notifyFd->fd() : -1; }
+
+    void acknowledgeNotify() {
+        _notifyFd->clear();
+        _notifyPending.exchange( false, std::memory_order_seq_cst );
+        // pairs with fence in _notify, consumer drains queue after this
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+    }
+
+    /** full bounded queue is handled according to overflow policy */
+    void enqueue( const T &data ) { emplace( data ); }
+    void enqueue( T &&data ) { emplace( std::move( data ) ); }
+
+    /** enqueue elements of range in order, with Locked backend they are
+     * appended under single lock acquisition, so consumer sees either none
+     * or all of them (unless queue is bounded and full); ring backends
+     * enqueue them one by one */
+    template< typename InputIt >
+    void enqueueBatch( InputIt first, InputIt last ) {
+        if ( _ring() ) {
+            for ( ; first != last; ++first )
+                enqueue( *first );
+            return;
+        }
+        if ( first == last )
+            return;
+        {
+            Guard g{ _lock };
+            for ( ; first != last; ++first ) {
+                if ( _policy == OverflowPolicy::Coalesce )
+                    _lockedCoalesce( g, T( *first ) );
+                else if ( _lockedMakeRoom( g ) )
+                    _queue.emplace_back( *first );
+            }
+            _cond.notify_all();
+        }
+        _notify();
+    }
+
+    /** construct element directly in queue */
+    template< typename... Args >
+    void emplace( Args &&...args ) {
+        if ( _ring() ) {
+            if ( _tryEmplace( std::forward< Args >( args )... )
+                    || _ringOverflow( std::forward< Args >( args )... ) )
+            {
+                _notEmpty.unpark();
+                _notify();
+            }
+            return;
+        }
+        {
+            Guard g{ _lock };
+            if ( _policy == OverflowPolicy::Coalesce )
+                _lockedCoalesce( g, T( std::forward< Args >( args )... ) );
+            else if ( _lockedMakeRoom( g ) ) {
+                _queue.emplace_back( std::forward< Args >( args )... );
+                _cond.notify_one();
+            } else
+                return;
+        }
+        _notify();
     }
 
     /** get and pop head of queue, this will block if queue is empty
      */
     T dequeue() {
+        if ( _ring() ) {
+            T data;
+            _ringPop( data, -1 );
+            return data;
+        }
         Guard g{ _lock };
         // wait for queue to become non-empty
         _cond.wait( g, [&]() { return !_queue.empty(); } );
-        T data = _queue.front();
-        _queue.pop_front();
-        return data;
+        return _lockedPop( g );
     }
 
     std::deque< T > dequeueAll() {
-        Guard g{ _lock };
         std::deque< T > ret;
+        if ( _ring() ) {
+            T data;
+            while ( _tryPop( data ) )
+                ret.push_back( std::move( data ) );
+            if ( !ret.empty() )
+                _notFull.unparkAll();
+            return ret;
+        }
+        Guard g{ _lock };
         std::swap( ret, _queue );
+        _notFullCond.notify_all();
         return ret;
     }
 
+    /** pop up to max elements from queue and write them to out, returns
+     * number of elements written, does not block, all elements are taken
+     * under single lock acquisition (or with single wakeup of producers
+     * for ring backends)
+     */
+    template< typename OutputIt >
+    size_t dequeueBatch( OutputIt out, size_t max ) {
+        return timeoutDequeueBatch( out, max, 0 );
+    }
+
+    /** same as dequeueBatch, but waits for up to ms milliseconds if queue
+     * is empty (ms < 0 means wait forever), returns 0 on timeout
+     */
+    template< typename OutputIt >
+    size_t timeoutDequeueBatch( OutputIt out, size_t max, long ms ) {
+        if ( max == 0 )
+            return 0;
+        size_t count = 0;
+        if ( _ring() ) {
+            T data;
+            if ( !_tryPop( data ) && ( ms == 0
+                    || !_parkUntil( _notEmpty, ms, [&]() { return _tryPop( data ); } ) ) )
+                return 0;
+            do {
+                *out++ = std::move( data );
+                ++count;
+            } while ( count < max && _tryPop( data ) );
+            _notFull.unpark( int( count ) );
+            return count;
+        }
+        Guard g{ _lock };
+        if ( ms < 0 )
+            _cond.wait( g, [&]() { return !_queue.empty(); } );
+        else if ( ms > 0 )
+            waitFor( _cond, g, ms, [&]() { return !_queue.empty(); } );
+        for ( ; count < max && !_queue.empty(); ++count )
+            *out++ = _lockedPop( g );
+        return count;
+    }
+
     /** get and pop head of queue, this will block for up to given number
      * of milliseconds, and it nothing arrives return nothing
      */
     wibble::Maybe< T > timeoutDequeue( long ms ) {
+        T data;
+        if ( timeoutDequeue( data, ms ) )
+            return wibble::Maybe< T >::Just( data );
+        return wibble::Maybe< T >::Nothing();
+    }
+
+    /** move-friendly version of timeoutDequeue, returns false on timeout */
+    bool timeoutDequeue( T &out, long ms ) {
+        if ( _ring() )
+            return _ringPop( out, ms );
         Guard g{ _lock };
         // wait for queue to become non-empty
-        if ( _cond.wait_for( g, toSystemTime( ms ),
-                [&]() { return !_queue.empty(); } ) )
+        if ( waitFor( _cond, g, ms, [&]() { return !_queue.empty(); } ) )
         {
-            T data = _queue.front();
-            _queue.pop_front();
-            return wibble::Maybe< T >::Just( data );
-        } else {
-            return wibble::Maybe< T >::Nothing();
+            out = _lockedPop( g );
+            return true;
         }
+        return false;
     }
 
     /** Try getting head of queue, or nothing if it is empty
      */
     wibble::Maybe< T > tryDequeue() {
-        Guard g{ _lock };
-        if ( _queue.empty() ) {
-            return wibble::Maybe< T >::Nothing();
-        } else {
-            auto it = wibble::Maybe< T >::Just( _queue.front() );
-            _queue.pop_front();
-            return it;
+        T data;
+        if ( tryDequeue( data ) )
+            return wibble::Maybe< T >::Just( data );
+        return wibble::Maybe< T >::Nothing();
+    }
+
+    /** move-friendly version of tryDequeue, returns false if queue is empty */
+    bool tryDequeue( T &out ) {
+        if ( _ring() ) {
+            if ( _tryPop( out ) ) {
+                _notFull.unpark();
+                return true;
+            }
+            return false;
         }
+        Guard g{ _lock };
+        if ( _queue.empty() )
+            return false;
+        out = _lockedPop( g );
+        return true;
     }
 
     /** not safe -- the fact that empty returns false does not guearantee
      * dequeue will not block
      */
     bool empty() {
+        if ( _ring() )
+            return _spsc ? _spsc->empty() : _mpmc->empty();
         Guard g{ _lock };
         return _queue.empty();
     }
 
   private:
+    using Guard = std::unique_lock< std::mutex >;
+
+    // overflow handling
+    const size_t _capacity;
+    const OverflowPolicy _policy;
+    CoalesceKey _key;
+    std::atomic< size_t > _dropped;
+    std::atomic< size_t > _coalesced;
+
+    // pollable notification
+    std::unique_ptr< EventFd > _notifyFd;
+    std::atomic< bool > _notifyPending;
+
+    /* signal eventfd only if it is not already signalled to avoid syscall
+     * for each element */
+    void _notify() {
+        if ( !_notifyFd )
+            return;
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( !_notifyPending.load( std::memory_order_relaxed )
+                && !_notifyPending.exchange( true, std::memory_order_seq_cst ) )
+            _notifyFd->signal();
+    }
+
+    // Locked backend
     std::mutex _lock;
     std::deque< T > _queue;
     std::condition_variable _cond;
-    using Guard = std::unique_lock< std::mutex >;
+    std::condition_variable _notFullCond;
+
+    T _lockedPop( Guard & ) {
+        T data = std::move( _queue.front() );
+        _queue.pop_front();
+        if ( _capacity != unbounded && ( _policy == OverflowPolicy::Block
+                    || _policy == OverflowPolicy::Coalesce ) )
+            _notFullCond.notify_one();
+        return data;
+    }
+
+    /* returns false if new element should be discarded */
+    bool _lockedMakeRoom( Guard &g ) {
+        if ( _capacity == unbounded || _queue.size() < _capacity )
+            return true;
+        switch ( _policy ) {
+            case OverflowPolicy::Block:
+                _notFullCond.wait( g, [&]() { return _queue.size() < _capacity; } );
+                return true;
+            case OverflowPolicy::DropNewest:
+                _dropped.fetch_add( 1, std::memory_order_relaxed );
+                return false;
+            case OverflowPolicy::DropOldest:
+                _queue.pop_front();
+                _dropped.fetch_add( 1, std::memory_order_relaxed );
+                return true;
+            case OverflowPolicy::Coalesce:
+                break;
+        }
+        assert_unreachable( "unhandled overflow policy" );
+    }
+
+    void _lockedCoalesce( Guard &g, T &&data ) {
+        const long key = _key( data );
+        const size_t window = std::min( _queue.size(), size_t( _coalesceWindow ) );
+        bool room = false;
+        // newest first, only keyed element which was not coalesced yet can
+        // be there
+        for ( size_t i = 0; key != noKey && !room && i < window; ++i )
+            if ( _key( _queue[ _queue.size() - 1 - i ] ) == key ) {
+                _queue.erase( _queue.end() - 1 - i );
+                _coalesced.fetch_add( 1, std::memory_order_relaxed );
+                room = true;
+            }
+        if ( !room && _queue.size() >= _capacity ) {
+            for ( size_t i = 0; !room && i < window; ++i )
+                if ( _key( _queue[ i ] ) != noKey ) {
+                    _queue.erase( _queue.begin() + i );
+                    _dropped.fetch_add( 1, std::memory_order_relaxed );
+                    room = true;
+                }
+            if ( !room && key != noKey ) {
+                _dropped.fetch_add( 1, std::memory_order_relaxed );
+                return;
+            }
+            if ( !room )
+                _notFullCond.wait( g, [&]() { return _queue.size() < _capacity; } );
+        }
+        _queue.push_back( std::move( data ) );
+        _cond.notify_one();
+    }
+
+    // ring backends
+    const QueueBackend _backend;
+    std::unique_ptr< _internal::MPMCRing< T > > _mpmc;
+    std::unique_ptr< _internal::SPSCRing< T > > _spsc;
+    Parker _notEmpty;
+    Parker _notFull;
+
+    bool _ring() const { return _backend != QueueBackend::Locked; }
+
+    template< typename... Args >
+    bool _tryEmplace( Args &&...args ) {
+        return _spsc ? _spsc->tryEmplace( std::forward< Args >( args )... )
+                     : _mpmc->tryEmplace( std::forward< Args >( args )... );
+    }
+
+    bool _tryPop( T &data ) {
+        return _spsc ? _spsc->tryPop( data ) : _mpmc->tryPop( data );
+    }
+
+    /* ring is full, returns true if element was inserted eventually */
+    template< typename... Args >
+    bool _ringOverflow( Args &&...args ) {
+        switch ( _policy ) {
+            case OverflowPolicy::Block:
+                _parkUntil( _notFull, -1, [&]() {
+                        return _tryEmplace( std::forward< Args >( args )... );
+                    } );
+                return true;
+            case OverflowPolicy::DropNewest:
+                _dropped.fetch_add( 1, std::memory_order_relaxed );
+                return false;
+            case OverflowPolicy::DropOldest: {
+                T old;
+                do {
+                    if ( _mpmc->tryPop( old ) )
+                        _dropped.fetch_add( 1, std::memory_order_relaxed );
+                } while ( !_tryEmplace( std::forward< Args >( args )... ) );
+                return true; }
+            case OverflowPolicy::Coalesce:
+                break;
+        }
+        assert_unreachable( "unhandled overflow policy" );
+    }
+
+    static constexpr int _spinCount = 64;
+    static const size_t _coalesceWindow = 64;
+
+    /* spin for a while on condition, if it does not succeed park on futex,
+     * returns false on timeout (ms < 0 means no timeout) */
+    template< typename Cond >
+    static bool _parkUntil( Parker &parker, long ms, Cond cond ) {
+        for ( int i = 0; i < _spinCount; ++i ) {
+            if ( cond() )
+                return true;
+            std::this_thread::yield();
+        }
+
+        MillisecondTime deadline = ms < 0 ? 0 : now() + ms;
+        for ( ;; ) {
+            uint32_t ticket = parker.prepare();
+            if ( cond() ) {
+                parker.cancel();
+                return true;
+            }
+            std::chrono::microseconds wait( -1 );
+            if ( ms >= 0 ) {
+                MillisecondTime remaining = deadline - now();
+                if ( remaining <= 0 ) {
+                    parker.cancel();
+                    return false;
+                }
+                wait = currentClock().realWait( remaining );
+            }
+            parker.park( ticket, wait );
+            if ( cond() )
+                return true;
+        }
+    }
+
+    bool _ringPop( T &data, long ms ) {
+        if ( _tryPop( data )
+                || _parkUntil( _notEmpty, ms, [&]() { return _tryPop( data ); } ) )
+        {
+            _notFull.unpark();
+            return true;
+        }
+        return false;
+    }
 };
 
 }
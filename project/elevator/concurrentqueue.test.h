@@ -3,6 +3,9 @@
 #include <thread>
 #include <vector>
 #include <atomic>
+#include <memory>
+#include <iterator>
+#include <chrono>
 
 #include <elevator/concurrentqueue.h>
 #include <elevator/test.h>
@@ -86,8 +89,7 @@ struct TestConcurrentQueue {
         }
     };
 
-    Test parallel() {
-        ConcurrentQueue< std::pair< int, int > > q;
+    void _parallel( ConcurrentQueue< std::pair< int, int > > &q ) {
         std::thread w1{ Writer{ 0, q } };
         std::thread w2{ Writer{ 1, q } };
         std::atomic< int > end{ 0 };
@@ -96,4 +98,234 @@ struct TestConcurrentQueue {
         w1.join(); w2.join();
         r1.join(); r2.join();
     }
+
+    Test parallel() {
+        ConcurrentQueue< std::pair< int, int > > q;
+        _parallel( q );
+    }
+
+    Test lockFreeSequential() {
+        ConcurrentQueue< int > q{ QueueBackend::LockFree, 128 };
+        assert( q.backend() == QueueBackend::LockFree, "wrong backend" );
+        for ( int i = 0; i < 100; ++i )
+            q.enqueue( i );
+        for ( int i = 0; i < 100; ++i )
+            assert_eq( q.dequeue(), i, "invalid data" );
+        assert( q.empty(), "should be empty" );
+        assert( q.tryDequeue().isNothing(), "should be empty" );
+        assert( q.timeoutDequeue( 10 ).isNothing(), "should be empty" );
+    }
+
+    Test lockFreeDequeueAll() {
+        ConcurrentQueue< int > q{ QueueBackend::LockFree, 16 };
+        for ( int i = 0; i < 10; ++i )
+            q.enqueue( i );
+        auto all = q.dequeueAll();
+        assert_eq( all.size(), 10ul, "wrong size" );
+        for ( int i = 0; i < 10; ++i )
+            assert_eq( all[ i ], i, "invalid data" );
+        assert( q.empty(), "should be empty" );
+    }
+
+    Test lockFreeBlocking() {
+        // small capacity forces both producer and consumer to park
+        ConcurrentQueue< int > q{ QueueBackend::LockFree, 4 };
+        std::thread prod( [&]() {
+                for ( int i = 0; i < 10000; ++i )
+                    q.enqueue( i );
+            } );
+        for ( int i = 0; i < 10000; ++i )
+            assert_eq( q.dequeue(), i, "invalid data" );
+        prod.join();
+        std::thread late( [&]() {
+                std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+                q.enqueue( 42 );
+            } );
+        auto x = q.timeoutDequeue( 5000 );
+        late.join();
+        assert( !x.isNothing(), "should be woken up" );
+        assert_eq( x.value(), 42, "invalid data" );
+    }
+
+    Test lockFreeParallel() {
+        ConcurrentQueue< std::pair< int, int > > q{ QueueBackend::LockFree, 256 };
+        _parallel( q );
+    }
+
+    Test spscSequential() {
+        ConcurrentQueue< int > q{ QueueBackend::SPSC, 128 };
+        assert( q.backend() == QueueBackend::SPSC, "wrong backend" );
+        for ( int i = 0; i < 100; ++i )
+            q.enqueue( i );
+        for ( int i = 0; i < 100; ++i ) {
+            auto x = q.tryDequeue();
+            assert( !x.isNothing(), "should not be empty" );
+            assert_eq( x.value(), i, "invalid data" );
+        }
+        assert( q.empty(), "should be empty" );
+        assert( q.timeoutDequeue( 10 ).isNothing(), "should be empty" );
+    }
+
+    Test spscParallel() {
+        ConcurrentQueue< std::pair< int, int > > q{ QueueBackend::SPSC, 64 };
+        std::thread w{ Writer{ 0, q } };
+        for ( int i = 0; i < 1000 * 1000; ++i ) {
+            auto x = q.dequeue();
+            assert_eq( x.first, 0, "invalid data" );
+            assert_eq( x.second, i, "invalid data" );
+        }
+        assert_eq( q.dequeue().second, -1, "missing end mark" );
+        w.join();
+        assert( q.empty(), "should be empty" );
+    }
+
+    void _moveOnly( ConcurrentQueue< std::unique_ptr< int > > &q ) {
+        for ( int i = 0; i < 10; ++i )
+            q.enqueue( std::unique_ptr< int >( new int( i ) ) );
+        q.emplace( new int( 10 ) );
+        for ( int i = 0; i < 5; ++i )
+            assert_eq( *q.dequeue(), i, "invalid data" );
+        std::unique_ptr< int > x;
+        assert( q.tryDequeue( x ), "should not be empty" );
+        assert_eq( *x, 5, "invalid data" );
+        assert( q.timeoutDequeue( x, 1 ), "should not be empty" );
+        assert_eq( *x, 6, "invalid data" );
+        auto rest = q.dequeueAll();
+        assert_eq( rest.size(), 4ul, "invalid size" );
+        assert_eq( *rest.back(), 10, "invalid data" );
+    }
+
+    Test moveOnly() {
+        ConcurrentQueue< std::unique_ptr< int > > q;
+        _moveOnly( q );
+        ConcurrentQueue< std::unique_ptr< int > > lf{ QueueBackend::LockFree, 16 };
+        _moveOnly( lf );
+        ConcurrentQueue< std::unique_ptr< int > > spsc{ QueueBackend::SPSC, 16 };
+        _moveOnly( spsc );
+    }
+
+    void _batch( ConcurrentQueue< int > &q ) {
+        std::vector< int > out;
+        assert_eq( q.dequeueBatch( std::back_inserter( out ), 8 ), 0ul, "should be empty" );
+        assert_eq( q.timeoutDequeueBatch( std::back_inserter( out ), 8, 1 ), 0ul, "should be empty" );
+        std::vector< int > in;
+        for ( int i = 0; i < 10; ++i )
+            q.enqueue( i );
+        for ( int i = 10; i < 20; ++i )
+            in.push_back( i );
+        q.enqueueBatch( in.begin(), in.end() );
+        q.enqueueBatch( in.end(), in.end() );
+        assert_eq( q.dequeueBatch( std::back_inserter( out ), 8 ), 8ul, "wrong batch" );
+        assert_eq( q.timeoutDequeueBatch( std::back_inserter( out ), 8, -1 ), 8ul, "wrong batch" );
+        assert_eq( q.dequeueBatch( std::back_inserter( out ), 8 ), 4ul, "wrong batch" );
+        assert_eq( out.size(), 20ul, "wrong size" );
+        for ( int i = 0; i < 20; ++i )
+            assert_eq( out[ i ], i, "invalid data" );
+        assert( q.empty(), "should be empty" );
+    }
+
+    Test batch() {
+        ConcurrentQueue< int > q;
+        _batch( q );
+        ConcurrentQueue< int > lf{ QueueBackend::LockFree, 32 };
+        _batch( lf );
+        ConcurrentQueue< int > spsc{ QueueBackend::SPSC, 32 };
+        _batch( spsc );
+    }
+
+    Test lockedBatchAtomic() {
+        ConcurrentQueue< int > q;
+        std::thread prod( [&]() {
+                std::vector< int > pair{ 0, 1 };
+                for ( int i = 0; i < 10000; ++i )
+                    q.enqueueBatch( pair.begin(), pair.end() );
+            } );
+        size_t total = 0;
+        while ( total < 20000 ) {
+            auto all = q.dequeueAll();
+            assert_eq( all.size() % 2, 0ul, "batch was split" );
+            total += all.size();
+        }
+        prod.join();
+    }
+
+    void _overflow( QueueBackend backend, OverflowPolicy policy ) {
+        ConcurrentQueue< int > q{ backend, 4, policy };
+        for ( int i = 0; i < 10; ++i )
+            q.enqueue( i );
+        assert_eq( q.dropped(), 6ul, "wrong drop count" );
+        auto all = q.dequeueAll();
+        assert_eq( all.size(), 4ul, "wrong size" );
+        int first = policy == OverflowPolicy::DropOldest ? 6 : 0;
+        for ( int i = 0; i < 4; ++i )
+            assert_eq( all[ i ], first + i, "invalid data" );
+    }
+
+    Test dropNewest() {
+        _overflow( QueueBackend::Locked, OverflowPolicy::DropNewest );
+        _overflow( QueueBackend::LockFree, OverflowPolicy::DropNewest );
+        _overflow( QueueBackend::SPSC, OverflowPolicy::DropNewest );
+    }
+
+    Test dropOldest() {
+        _overflow( QueueBackend::Locked, OverflowPolicy::DropOldest );
+        _overflow( QueueBackend::LockFree, OverflowPolicy::DropOldest );
+    }
+
+    Test lockedBlocking() {
+        ConcurrentQueue< int > q{ QueueBackend::Locked, 4 };
+        std::thread prod( [&]() {
+                for ( int i = 0; i < 10000; ++i )
+                    q.enqueue( i );
+            } );
+        for ( int i = 0; i < 10000; ++i )
+            assert_eq( q.dequeue(), i, "invalid data" );
+        prod.join();
+        assert_eq( q.dropped(), 0ul, "nothing should be dropped" );
+    }
+
+    Test coalesce() {
+        // pairs of ( key, value ), only elements with key >= 0 coalesce
+        using P = std::pair< int, int >;
+        ConcurrentQueue< P > q{ QueueBackend::Locked, 4, OverflowPolicy::Coalesce,
+            []( const P &p ) { return long( p.first ); } };
+        q.enqueue( P( 0, 0 ) );
+        q.enqueue( P( -1, 1 ) );
+        q.enqueue( P( 1, 2 ) );
+        q.enqueue( P( 0, 3 ) ); // coalesces with ( 0, 0 )
+        q.enqueue( P( -1, 4 ) );
+        assert_eq( q.coalesced(), 1ul, "wrong coalesce count" );
+        assert_eq( q.dropped(), 0ul, "wrong drop count" );
+        q.enqueue( P( -1, 5 ) ); // full, drops ( 1, 2 ), not ( -1, 1 )
+        assert_eq( q.dropped(), 1ul, "wrong drop count" );
+        auto all = q.dequeueAll();
+        assert_eq( all.size(), 4ul, "wrong size" );
+        assert_eq( all[ 0 ].second, 1, "invalid data" );
+        assert_eq( all[ 1 ].second, 3, "invalid data" );
+        assert_eq( all[ 2 ].second, 4, "invalid data" );
+        assert_eq( all[ 3 ].second, 5, "invalid data" );
+    }
+
+    Test coalesceNeverDropsUnkeyed() {
+        using P = std::pair< int, int >;
+        ConcurrentQueue< P > q{ QueueBackend::Locked, 2, OverflowPolicy::Coalesce,
+            []( const P &p ) { return long( p.first ); } };
+        q.enqueue( P( -1, 0 ) );
+        q.enqueue( P( -1, 1 ) );
+        q.enqueue( P( 0, 2 ) ); // full of unkeyed elements, incoming is dropped
+        assert_eq( q.dropped(), 1ul, "wrong drop count" );
+
+        std::atomic< bool > done( false );
+        std::thread prod( [&]() {
+                q.enqueue( P( -1, 3 ) ); // must wait for space
+                done = true;
+            } );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 50 ) );
+        assert( !done, "unkeyed element must not be dropped" );
+        assert_eq( q.dequeue().second, 0, "invalid data" );
+        prod.join();
+        assert_eq( q.dequeue().second, 1, "invalid data" );
+        assert_eq( q.dequeue().second, 3, "invalid data" );
+        assert_eq( q.dropped(), 1ul, "wrong drop count" );
+    }
 };
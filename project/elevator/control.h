@@ -0,0 +1,145 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* State machine of elevator control loop (see Elevator::_loop)
+ *
+ * Transitions are given by list of rules below, from which full table
+ * indexed by (state, event) is generated at compile time. Each cycle loop
+ * collects mask of events which are active and state machine picks the one
+ * with highest priority (lowest value) among those current state reacts to,
+ * dispatch is then one table lookup. Events without rule are ignored (state
+ * stays and no action is run).
+ */
+
+#include <array>
+#include <cstdint>
+
+#ifndef SRC_CONTROL_H
+#define SRC_CONTROL_H
+
+namespace elevator {
+namespace control {
+
+enum class State : uint8_t { Normal, WaitingForInButton, Stopped };
+const int stateCount = 3;
+
+// in order of priority
+enum class Event : uint8_t {
+    StopOn,      // stop button pressed, elevator is now stopped
+    StopOff,     // stop button pressed again, elevator can continue
+    Arrived,     // at floor where we should stop
+    DoorTimeout, // doors were open for too long
+    InButton,    // inside button pressed while doors are open
+    Idle,        // not moving
+    None         // always active
+};
+const int eventCount = 7;
+
+enum class Action : uint8_t {
+    None, Halt, Resume, Arrive, CloseDoor, CloseDoorTimeout, Idle
+};
+const int actionCount = 7;
+
+using EventMask = uint32_t;
+
+constexpr EventMask bit( Event e, bool active = true ) {
+    return EventMask( active ) << int( e );
+}
+
+struct Transition {
+    State next;
+    Action action;
+};
+
+namespace _internal {
+
+const State anyState = State( 0xff );
+
+struct Rule {
+    State from;
+    Event event;
+    State next;
+    Action action;
+};
+
+constexpr Rule rules[] = {
+    { anyState,                  Event::StopOn,      State::Stopped, Action::Halt },
+    { anyState,                  Event::StopOff,     State::Normal,  Action::Resume },
+    { State::Normal,             Event::Arrived,     State::WaitingForInButton, Action::Arrive },
+    { State::Normal,             Event::Idle,        State::Normal,  Action::Idle },
+    { State::WaitingForInButton, Event::DoorTimeout, State::Normal,  Action::CloseDoorTimeout },
+    { State::WaitingForInButton, Event::InButton,    State::Normal,  Action::CloseDoor },
+};
+const int ruleCount = sizeof( rules ) / sizeof( rules[ 0 ] );
+
+constexpr bool matches( const Rule &r, State s, Event e ) {
+    return r.event == e && ( r.from == anyState || r.from == s );
+}
+
+constexpr Transition find( State s, Event e, int i = 0 ) {
+    return i == ruleCount
+        ? Transition{ s, Action::None }
+        : matches( rules[ i ], s, e )
+            ? Transition{ rules[ i ].next, rules[ i ].action }
+            : find( s, e, i + 1 );
+}
+
+constexpr EventMask sensitivity( State s, int e = 0 ) {
+    return e == eventCount
+        ? bit( Event::None )
+        : bit( Event( e ), find( s, Event( e ) ).action != Action::None )
+            | sensitivity( s, e + 1 );
+}
+
+template< int... > struct Indices { };
+template< int N, int... Is >
+struct MakeIndices : MakeIndices< N - 1, N - 1, Is... > { };
+template< int... Is >
+struct MakeIndices< 0, Is... > { using Type = Indices< Is... >; };
+
+using TransitionTable = std::array< Transition, stateCount * eventCount >;
+using SensitivityTable = std::array< EventMask, stateCount >;
+
+template< int... Is >
+constexpr TransitionTable makeTable( Indices< Is... > ) {
+    return TransitionTable{ { find( State( Is / eventCount ), Event( Is % eventCount ) )... } };
+}
+
+template< int... Is >
+constexpr SensitivityTable makeSensitivity( Indices< Is... > ) {
+    return SensitivityTable{ { sensitivity( State( Is ) )... } };
+}
+
+}
+
+/** transition for given state and event, usable in constant expressions */
+constexpr Transition transition( State s, Event e ) {
+    return _internal::find( s, e );
+}
+
+/** full transition table, indexed by state * eventCount + event */
+inline const _internal::TransitionTable &table() {
+    static constexpr _internal::TransitionTable t = _internal::makeTable(
+            _internal::MakeIndices< stateCount * eventCount >::Type() );
+    return t;
+}
+
+/** events given state reacts to (always includes Event::None) */
+inline EventMask sensitivity( State s ) {
+    static constexpr _internal::SensitivityTable t = _internal::makeSensitivity(
+            _internal::MakeIndices< stateCount >::Type() );
+    return t[ int( s ) ];
+}
+
+/** active event with highest priority which state reacts to */
+inline Event select( State s, EventMask active ) {
+    return Event( __builtin_ctz( ( active | bit( Event::None ) ) & sensitivity( s ) ) );
+}
+
+inline const Transition &dispatch( State s, Event e ) {
+    return table()[ int( s ) * eventCount + int( e ) ];
+}
+
+}
+}
+
+#endif // SRC_CONTROL_H
@@ -0,0 +1,50 @@
+#include <elevator/control.h>
+#include <elevator/test.h>
+
+using namespace elevator::control;
+
+// table is generated at compile time
+static_assert( transition( State::Normal, Event::Arrived ).next == State::WaitingForInButton,
+        "arrival opens doors" );
+static_assert( transition( State::Stopped, Event::Idle ).action == Action::None,
+        "stopped elevator ignores requests" );
+
+struct TestControl {
+
+    Test table() {
+        const auto &t = elevator::control::table();
+        assert_eq( int( t.size() ), stateCount * eventCount, "table size" );
+        for ( int s = 0; s < stateCount; ++s ) {
+            const State st = State( s );
+            // stop button works in any state
+            assert( dispatch( st, Event::StopOn ).next == State::Stopped, "stop" );
+            assert( dispatch( st, Event::StopOn ).action == Action::Halt, "stop" );
+            assert( dispatch( st, Event::StopOff ).next == State::Normal, "resume" );
+            assert( dispatch( st, Event::StopOff ).action == Action::Resume, "resume" );
+            // nothing happens without event
+            assert( dispatch( st, Event::None ).next == st, "none" );
+            assert( dispatch( st, Event::None ).action == Action::None, "none" );
+        }
+        assert( dispatch( State::Normal, Event::Idle ).action == Action::Idle, "idle" );
+        assert( dispatch( State::WaitingForInButton, Event::InButton ).next == State::Normal,
+                "close doors" );
+        assert( dispatch( State::WaitingForInButton, Event::DoorTimeout ).action
+                == Action::CloseDoorTimeout, "door timeout" );
+        assert( dispatch( State::WaitingForInButton, Event::Arrived ).action == Action::None,
+                "already at floor" );
+    }
+
+    Test select() {
+        const EventMask all = bit( Event::Arrived ) | bit( Event::DoorTimeout )
+            | bit( Event::InButton ) | bit( Event::Idle );
+        assert( elevator::control::select( State::Normal, all ) == Event::Arrived, "priority" );
+        assert( elevator::control::select( State::Normal, bit( Event::DoorTimeout ) | bit( Event::Idle ) )
+                == Event::Idle, "door timeout ignored when doors are closed" );
+        assert( elevator::control::select( State::WaitingForInButton, all ) == Event::DoorTimeout,
+                "timeout wins" );
+        assert( elevator::control::select( State::WaitingForInButton, bit( Event::Idle ) )
+                == Event::None, "idle ignored when doors are open" );
+        assert( elevator::control::select( State::Stopped, all ) == Event::None, "stopped" );
+        assert( elevator::control::select( State::Normal, 0 ) == Event::None, "no event" );
+    }
+};
@@ -0,0 +1,249 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/dispatch.h>
+#include <elevator/test.h>
+
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+#include <numeric>
+
+namespace elevator {
+
+std::unique_ptr< DispatchEngine > DispatchEngine::create( const std::string &name,
+        BasicDriverInfo bounds )
+{
+    if ( name == "eta" )
+        return std::unique_ptr< DispatchEngine >( new EtaDispatch( bounds ) );
+    if ( name == "distance" )
+        return std::unique_ptr< DispatchEngine >( new DistanceDispatch( bounds ) );
+    assert_unreachable( "unknown dispatch engine" );
+}
+
+void DistanceDispatch::costs( const FleetTable &fleet, Button call,
+        std::vector< int > &costs ) const
+{
+    const int n = fleet.size();
+    const int span = _bounds.maxFloor() - _bounds.minFloor() + 1;
+    const int floor = call.floor();
+    const bool up = call.type() == ButtonType::CallUp;
+
+    // branch-free cost evaluation over fleet arrays
+    costs.resize( n );
+    for ( int i = 0; i < n; ++i ) {
+        // absent elevators have invalid floor, avoid overflow
+        const int last = fleet.present[ i ] ? fleet.lastFloor[ i ] : floor;
+        const Direction dir = fleet.direction[ i ];
+        const bool busy =
+            ( dir == Direction::Up
+                && ( ( up && floor > last ) || floor == _bounds.maxFloor() ) )
+            || ( dir == Direction::Down
+                && ( ( !up && floor < last ) || floor == _bounds.minFloor() ) );
+
+        int dist = std::abs( last - floor );
+        // penalizations for non-idle elevators
+        dist += fleet.stopped[ i ] ? 10 * (span - 1) : 0;
+        dist += busy ? span : 0; // busy
+        // as a last resort we can schedule floor even to elevator which
+        // is running in different direction
+        dist += !busy && dir != Direction::None ? 2 * span : 0;
+        costs[ i ] = fleet.present[ i ] ? dist : INT_MAX;
+    }
+}
+
+void EtaDispatch::costs( const FleetTable &fleet, Button call,
+        std::vector< int > &costs ) const
+{
+    costs.resize( fleet.size() );
+    for ( int i = 0; i < fleet.size(); ++i )
+        costs[ i ] = cost( fleet, i, call );
+}
+
+int EtaDispatch::cost( const FleetTable &fleet, int id, Button call ) const {
+    if ( !fleet.present[ id ] )
+        return INT_MAX;
+
+    const BasicDriverInfo &b = _bounds;
+    const int target = call.floor();
+    const Direction callDir = call.type() == ButtonType::CallUp
+        ? Direction::Up : Direction::Down;
+
+    // copies, requests are removed as they are served on simulated route
+    // destinations of passengers not picked up yet are approximated as
+    // inside requests
+    FloorSet inside = fleet.insideButtons[ id ] | fleet.destinations[ id ];
+    FloorSet ups = fleet.upButtons[ id ];
+    FloorSet downs = fleet.downButtons[ id ];
+
+    int pos = std::max( b.minFloor(), std::min( fleet.lastFloor[ id ], b.maxFloor() ) );
+    Direction dir = fleet.direction[ id ];
+    if ( dir == Direction::None )
+        dir = target > pos ? Direction::Up : target < pos ? Direction::Down : callDir;
+
+    // call on floor where elevator stops anyway delays nobody
+    const bool alreadyStops = inside.get( target, b )
+        || ( callDir == Direction::Up ? ups : downs ).get( target, b );
+
+    MillisecondTime time = fleet.stopped[ id ] ? _timing.stoppedPenalty : 0;
+    if ( fleet.doorOpen[ id ] )
+        time += _timing.dwellTime / 2; // on average half of dwell remains
+
+    auto ahead = [&]( int floor ) {
+        return dir == Direction::Up ? floor > pos : floor < pos;
+    };
+    auto anyBeyond = [&]( const FloorSet &set, int floor ) {
+        return dir == Direction::Up ? set.anyHigher( floor, b ) : set.anyLower( floor, b );
+    };
+    auto nearest = [&]( const FloorSet &set ) {
+        return dir == Direction::Up ? set.nextHigher( pos, b ) : set.nextLower( pos, b );
+    };
+    auto farthest = [&]( const FloorSet &set ) {
+        if ( dir == Direction::Up )
+            return !set.anyHigher( pos, b ) ? INT_MIN
+                : set.get( b.maxFloor(), b ) ? b.maxFloor() : set.nextLower( b.maxFloor(), b );
+        return !set.anyLower( pos, b ) ? INT_MIN
+            : set.get( b.minFloor(), b ) ? b.minFloor() : set.nextHigher( b.minFloor(), b );
+    };
+    auto moveTo = [&]( int floor ) {
+        time += std::abs( floor - pos ) * _timing.floorTime;
+        pos = floor;
+    };
+    auto stopAt = [&]( int floor ) {
+        moveTo( floor );
+        time += _timing.dwellTime;
+        inside.set( false, floor, b );
+        ( dir == Direction::Up ? ups : downs ).set( false, floor, b );
+    };
+
+    // every iteration serves at least one request or reverses direction
+    const int span = b.maxFloor() - b.minFloor() + 1;
+    for ( int guard = 0; guard < 4 * span + 4; ++guard ) {
+        const FloorSet all = inside | ups | downs;
+        // call floor is served either in its direction or as reversal point
+        const bool serves = callDir == dir || !anyBeyond( all, target );
+        if ( pos == target && serves )
+            break;
+
+        FloorSet &sameDir = dir == Direction::Up ? ups : downs;
+        const int next = nearest( inside | sameDir );
+        const bool stopBefore = next != INT_MIN
+            && ( dir == Direction::Up ? next < target : next > target );
+        if ( serves && ahead( target ) && !stopBefore ) {
+            moveTo( target );
+            continue;
+        }
+        if ( next != INT_MIN ) {
+            stopAt( next );
+            continue;
+        }
+        // nothing more in this direction but calls in opposite direction
+        const int far = farthest( dir == Direction::Up ? downs : ups );
+        if ( far != INT_MIN ) {
+            moveTo( far );
+            time += _timing.dwellTime;
+            ( dir == Direction::Up ? downs : ups ).set( false, far, b );
+            inside.set( false, far, b );
+        }
+        dir = dir == Direction::Up ? Direction::Down : Direction::Up;
+    }
+
+    // riders inside which are served after the call are delayed by the stop
+    if ( !alreadyStops )
+        time += MillisecondTime( _timing.journeyWeight * _timing.dwellTime * inside.count() );
+    return int( std::min( time, MillisecondTime( INT_MAX - 1 ) ) );
+}
+
+std::vector< CallMove > reassignCalls( const DispatchEngine &engine, FleetTable fleet,
+        BasicDriverInfo b, std::function< bool( int, Button ) > movable,
+        int minGain, int maxMoves )
+{
+    std::vector< CallMove > moves;
+    std::vector< int > costs;
+    FloorSet movedUp, movedDown;
+
+    auto calls = [&]( ButtonType type, int id ) -> FloorSet & {
+        return type == ButtonType::CallUp ? fleet.upButtons[ id ] : fleet.downButtons[ id ];
+    };
+
+    while ( int( moves.size() ) < maxMoves ) {
+        CallMove best{ Button(), INT_MIN, INT_MIN, minGain - 1 };
+        for ( int id = 0; id < fleet.size(); ++id ) {
+            if ( !fleet.present[ id ] )
+                continue;
+            for ( ButtonType type : { ButtonType::CallUp, ButtonType::CallDown } ) {
+                const FloorSet &moved = type == ButtonType::CallUp ? movedUp : movedDown;
+                FloorSet &set = calls( type, id );
+                for ( int f = set.lowest( b ); f != INT_MIN; f = set.nextHigher( f, b ) ) {
+                    const Button call( type, f );
+                    if ( moved.get( f, b ) || !movable( id, call ) )
+                        continue;
+                    // cost of the call as if it was not assigned yet
+                    set.set( false, f, b );
+                    engine.costs( fleet, call, costs );
+                    set.set( true, f, b );
+
+                    const int to = int( std::min_element( costs.begin(), costs.end() )
+                                        - costs.begin() );
+                    if ( to == id || costs[ id ] == INT_MAX )
+                        continue;
+                    const int gain = costs[ id ] - costs[ to ];
+                    if ( gain > best.gain )
+                        best = CallMove{ call, id, to, gain };
+                }
+            }
+        }
+        if ( best.from == INT_MIN )
+            break;
+
+        const int floor = best.call.floor();
+        calls( best.call.type(), best.from ).set( false, floor, b );
+        calls( best.call.type(), best.to ).set( true, floor, b );
+        ( best.call.type() == ButtonType::CallUp ? movedUp : movedDown ).set( true, floor, b );
+        moves.push_back( best );
+    }
+    return moves;
+}
+
+std::vector< int > assignDestinations( const DispatchEngine &engine, FleetTable fleet,
+        BasicDriverInfo b, const std::vector< DestinationCall > &calls )
+{
+    std::vector< int > order( calls.size() );
+    std::iota( order.begin(), order.end(), 0 );
+    std::stable_sort( order.begin(), order.end(), [&]( int x, int y ) {
+            return calls[ x ].tuple() < calls[ y ].tuple();
+        } );
+
+    std::vector< int > assigned( calls.size(), INT_MIN );
+    std::vector< int > costs;
+    for ( int i : order ) {
+        const DestinationCall &call = calls[ i ];
+        const Button pickup = call.pickup();
+        engine.costs( fleet, pickup, costs );
+        const bool up = pickup.type() == ButtonType::CallUp;
+        for ( int id = 0; id < int( costs.size() ); ++id ) {
+            if ( costs[ id ] == INT_MAX )
+                continue;
+            const FloorSet stops = fleet.insideButtons[ id ] | fleet.destinations[ id ]
+                | ( up ? fleet.upButtons[ id ] : fleet.downButtons[ id ] );
+            const bool dest = stops.get( call.destination, b );
+            // passenger is delayed by stops on the way ...
+            const int between = up
+                ? stops.countHigher( call.origin, b ) - stops.countHigher( call.destination, b )
+                : stops.countLower( call.origin, b ) - stops.countLower( call.destination, b );
+            costs[ id ] += ( between - dest ) * engine.stopCost();
+            // ... and new destination is extra stop for the elevator
+            costs[ id ] += dest ? 0 : engine.stopCost();
+        }
+        auto min = std::min_element( costs.begin(), costs.end() );
+        if ( min == costs.end() || *min == INT_MAX )
+            continue;
+
+        const int id = assigned[ i ] = int( min - costs.begin() );
+        ( pickup.type() == ButtonType::CallUp ? fleet.upButtons : fleet.downButtons )[ id ]
+            .set( true, call.origin, b );
+        fleet.destinations[ id ].set( true, call.destination, b );
+    }
+    return assigned;
+}
+
+}
@@ -0,0 +1,121 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Dispatch engines used by Scheduler to select which elevator serves hall
+ * call, engine computes cost of each elevator of fleet and scheduler picks
+ * the cheapest one
+ */
+
+#include <elevator/state.h>
+#include <elevator/driver.h>
+#include <elevator/time.h>
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <functional>
+
+#ifndef SRC_DISPATCH_H
+#define SRC_DISPATCH_H
+
+namespace elevator {
+
+struct DispatchEngine {
+    virtual ~DispatchEngine() { }
+
+    /** fill costs (indexed by elevator id) of serving call (CallUp or
+     * CallDown button) by each elevator, INT_MAX if elevator is not present
+     */
+    virtual void costs( const FleetTable &, Button call, std::vector< int > &costs ) const = 0;
+
+    /** smallest decrease of cost for which it pays off to move already
+     * assigned call to other elevator (in units of costs) */
+    virtual int hysteresis() const = 0;
+
+    /** cost of one additional stop of elevator (used to group passengers
+     * with same destination in destination dispatch mode) */
+    virtual int stopCost() const = 0;
+
+    /** engine by name ("eta" or "distance") */
+    static std::unique_ptr< DispatchEngine > create( const std::string &name, BasicDriverInfo );
+};
+
+/* cost is distance to call floor plus fixed penalties for stopped elevators,
+ * elevators which will pass the floor in wrong direction and elevators
+ * moving away from call */
+struct DistanceDispatch : DispatchEngine {
+    explicit DistanceDispatch( BasicDriverInfo bounds ) : _bounds( bounds ) { }
+
+    void costs( const FleetTable &, Button, std::vector< int > & ) const override;
+    int hysteresis() const override { return 2; }
+    int stopCost() const override { return 1; }
+
+  private:
+    BasicDriverInfo _bounds;
+};
+
+/* cost is estimated time of arrival (in milliseconds): route of elevator is
+ * simulated with its committed stops (collective control: stops for inside
+ * buttons and for calls in direction of travel, reverses after last request
+ * in direction), each floor takes floorTime and each stop dwellTime; each
+ * inside request which would be served after the call is delayed by the
+ * extra stop, this is added with weight journeyWeight
+ */
+struct EtaDispatch : DispatchEngine {
+    struct Timing {
+        Timing() : floorTime( 2500 ), dwellTime( 5000 ), journeyWeight( 1 ),
+            stoppedPenalty( 600000 )
+        { }
+        MillisecondTime floorTime;
+        MillisecondTime dwellTime;
+        double journeyWeight;
+        MillisecondTime stoppedPenalty; // elevator stopped by stop button
+    };
+
+    explicit EtaDispatch( BasicDriverInfo bounds, Timing timing = Timing() ) :
+        _bounds( bounds ), _timing( timing )
+    { }
+
+    void costs( const FleetTable &, Button, std::vector< int > & ) const override;
+    int hysteresis() const override { return int( 2 * _timing.floorTime ); }
+    int stopCost() const override { return int( _timing.dwellTime ); }
+
+    /** cost for single elevator of fleet */
+    int cost( const FleetTable &, int id, Button ) const;
+
+  private:
+    BasicDriverInfo _bounds;
+    Timing _timing;
+};
+
+/* hall call moved from one elevator to another by reassignCalls */
+struct CallMove {
+    Button call;
+    int from;
+    int to;
+    int gain; // decrease of cost of the call
+};
+
+/** bounded local search over assignment of outstanding hall calls (calls
+ * sharing elevator do not have additive costs, so this is not a linear
+ * assignment problem): each step moves the call which gains most by moving
+ * to its cheapest elevator and updates fleet accordingly, search stops when
+ * no call gains at least minGain or after maxMoves moves; only calls for
+ * which movable( id, call ) holds are considered and each moves at most once
+ */
+std::vector< CallMove > reassignCalls( const DispatchEngine &, FleetTable fleet,
+        BasicDriverInfo, std::function< bool( int, Button ) > movable,
+        int minGain, int maxMoves );
+
+/** batch assignment for destination dispatch: passengers are processed
+ * ordered by origin and destination, each goes to elevator with lowest cost
+ * of pick up plus stopCost for each stop of the elevator between origin and
+ * destination and for destination if it is not yet a stop, so passengers
+ * travelling together share elevator; fleet is updated after each assignment; returns elevator for
+ * each call (in order of calls), INT_MIN if no elevator is present
+ */
+std::vector< int > assignDestinations( const DispatchEngine &, FleetTable fleet,
+        BasicDriverInfo, const std::vector< DestinationCall > & );
+
+}
+
+#endif // SRC_DISPATCH_H
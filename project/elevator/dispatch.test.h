@@ -0,0 +1,124 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/dispatch.h>
+#include <elevator/test.h>
+#include <climits>
+
+using namespace elevator;
+
+struct TestDispatch {
+
+    BasicDriverInfo bi{ 1, 8 };
+    EtaDispatch::Timing timing;
+
+    ElevatorState _state( int id, int floor, Direction dir ) {
+        ElevatorState st;
+        st.id = id;
+        st.lastFloor = floor;
+        st.direction = dir;
+        st.doorOpen = false;
+        return st;
+    }
+
+    Test idle() {
+        FleetTable fleet;
+        fleet.set( _state( 0, 1, Direction::None ) );
+        EtaDispatch eta{ bi };
+        assert_eq( eta.cost( fleet, 0, Button( ButtonType::CallUp, 3 ) ),
+                2 * timing.floorTime, "idle car goes directly" );
+        assert_eq( eta.cost( fleet, 0, Button( ButtonType::CallDown, 1 ) ), 0, "already there" );
+    }
+
+    Test committedStops() {
+        FleetTable fleet;
+        auto st = _state( 0, 1, Direction::Up );
+        st.insideButtons.set( true, 4, bi );
+        fleet.set( st );
+        EtaDispatch eta{ bi };
+        // goes to 4 first, stops there and then returns to 2
+        assert_eq( eta.cost( fleet, 0, Button( ButtonType::CallDown, 2 ) ),
+                5 * timing.floorTime + timing.dwellTime, "reversal" );
+        // up call on the way, rider to 4 is delayed by the stop
+        assert_eq( eta.cost( fleet, 0, Button( ButtonType::CallUp, 2 ) ),
+                timing.floorTime + timing.dwellTime, "on the way" );
+    }
+
+    Test unavailable() {
+        FleetTable fleet;
+        auto st = _state( 1, 1, Direction::None );
+        st.stopped = true;
+        fleet.set( st );
+        std::vector< int > costs;
+        EtaDispatch{ bi }.costs( fleet, Button( ButtonType::CallUp, 2 ), costs );
+        assert_eq( costs.size(), 2ul, "costs for all ids" );
+        assert_eq( costs[ 0 ], INT_MAX, "absent" );
+        assert_lt( timing.stoppedPenalty, costs[ 1 ], "stopped" );
+    }
+
+    Test passingCar() {
+        // car 0 passes call floor in right direction, car 1 is idle but far
+        FleetTable fleet;
+        auto st = _state( 0, 5, Direction::Up );
+        st.insideButtons.set( true, 8, bi );
+        fleet.set( st );
+        fleet.set( _state( 1, 1, Direction::None ) );
+        const Button call( ButtonType::CallUp, 6 );
+
+        std::vector< int > costs;
+        DistanceDispatch{ bi }.costs( fleet, call, costs );
+        assert_lt( costs[ 1 ], costs[ 0 ], "distance prefers idle car" );
+        EtaDispatch{ bi }.costs( fleet, call, costs );
+        assert_lt( costs[ 0 ], costs[ 1 ], "eta prefers passing car" );
+    }
+
+    Test reassign() {
+        FleetTable fleet;
+        auto st = _state( 0, 2, Direction::Up );
+        st.insideButtons.set( true, 8, bi );
+        st.downButtons.set( true, 3, bi ); // served only after return from 8
+        st.upButtons.set( true, 5, bi );   // on the way
+        fleet.set( st );
+        fleet.set( _state( 1, 1, Direction::None ) );
+        EtaDispatch eta{ bi };
+        auto any = []( int, Button ) { return true; };
+
+        auto moves = reassignCalls( eta, fleet, bi, any, eta.hysteresis(), 10 );
+        assert_eq( moves.size(), 1ul, "only call behind car is moved" );
+        assert( moves[ 0 ].call.type() == ButtonType::CallDown, "moved call" );
+        assert_eq( moves[ 0 ].call.floor(), 3, "moved call" );
+        assert_eq( moves[ 0 ].from, 0, "moved call" );
+        assert_eq( moves[ 0 ].to, 1, "moved call" );
+
+        assert( reassignCalls( eta, fleet, bi, any, eta.hysteresis(), 0 ).empty(), "bounded" );
+        assert( reassignCalls( eta, fleet, bi, []( int id, Button ) { return id != 0; },
+                    eta.hysteresis(), 10 ).empty(), "not movable" );
+    }
+
+    Test hysteresis() {
+        // both cars equally good, call stays where it is
+        FleetTable fleet;
+        auto st = _state( 0, 1, Direction::None );
+        st.upButtons.set( true, 3, bi );
+        fleet.set( st );
+        fleet.set( _state( 1, 1, Direction::None ) );
+        EtaDispatch eta{ bi };
+        assert( reassignCalls( eta, fleet, bi, []( int, Button ) { return true; },
+                    eta.hysteresis(), 10 ).empty(), "no gain" );
+    }
+
+    Test destinations() {
+        // up-peak: both cars wait in lobby, passengers are grouped by destination
+        FleetTable fleet;
+        fleet.set( _state( 0, 1, Direction::None ) );
+        fleet.set( _state( 1, 1, Direction::None ) );
+        std::vector< DestinationCall > batch{ { 1, 7 }, { 1, 5 }, { 1, 7 }, { 1, 5 } };
+        auto cars = assignDestinations( EtaDispatch{ bi }, fleet, bi, batch );
+        assert_eq( cars.size(), batch.size(), "all assigned" );
+        assert_eq( cars[ 1 ], cars[ 3 ], "same destination, same car" );
+        assert_eq( cars[ 0 ], cars[ 2 ], "same destination, same car" );
+        assert_neq( cars[ 0 ], cars[ 1 ], "different destinations, different cars" );
+
+        auto none = assignDestinations( EtaDispatch{ bi }, FleetTable(), bi, batch );
+        assert_eq( none[ 0 ], INT_MIN, "no car present" );
+    }
+};
@@ -3,42 +3,16 @@
 
 #include <elevator/test.h>
 #include <elevator/driver.h>
-#include <elevator/channels.h>
 
 namespace elevator {
 
-static const int N_FLOORS = 4;
-static const int N_BUTTONS = 3;
-
-static const std::array< std::array< int, N_BUTTONS >, N_FLOORS > lampChannelMatrix{ {
-    { { LIGHT_UP1, LIGHT_DOWN1, LIGHT_COMMAND1 } },
-    { { LIGHT_UP2, LIGHT_DOWN2, LIGHT_COMMAND2 } },
-    { { LIGHT_UP3, LIGHT_DOWN3, LIGHT_COMMAND3 } },
-    { { LIGHT_UP4, LIGHT_DOWN4, LIGHT_COMMAND4 } },
-} };
-
-static const std::array< std::array< int, N_BUTTONS >, N_FLOORS > buttonChannelMatrix{ {
-    { { FLOOR_UP1, FLOOR_DOWN1, FLOOR_COMMAND1 } },
-    { { FLOOR_UP2, FLOOR_DOWN2, FLOOR_COMMAND2 } },
-    { { FLOOR_UP3, FLOOR_DOWN3, FLOOR_COMMAND3 } },
-    { { FLOOR_UP4, FLOOR_DOWN4, FLOOR_COMMAND4 } },
-} };
-
-int lamp( Button btn ) {
-    assert_leq( btn.floor(), int( lampChannelMatrix.size() ), "out-of-bounds" );
-    assert_leq( 1, btn.floor(), "out-of-bounds" );
-
-    return lampChannelMatrix[ btn.floor() - 1 ][ int( btn.type() ) ];
-}
-
-int button( Button btn ) {
-    assert_leq( btn.floor(), int( buttonChannelMatrix.size() ), "out-of-bounds" );
-    assert_leq( 1, btn.floor(), "out-of-bounds" );
-
-    return buttonChannelMatrix[ btn.floor() - 1 ][ int( btn.type() ) ];
-}
-
-Driver::Driver() : BasicDriverInfo( 1, 4 ) {
+Driver::Driver( const Layout &layout, const char *device ) :
+    BasicDriverInfo( layout.minFloor, layout.maxFloor ),
+    _layout( layout ), _lastDirection( Direction::None ), _lio( device )
+{
+    _layout.assertConsistency();
+    _setupChannels();
+    _shadow = _lio.io_read_ports( _outputPorts );
     stopElevator(); // for safety reasons
 }
 
@@ -48,6 +22,56 @@ Driver::Driver() : BasicDriverInfo( 1, 4 ) {
  */
 Driver::~Driver() { stopElevator(); }
 
+/* precompute what is connected to each input channel, so that whole input
+ * ports can be decoded by iterating only over active bits */
+void Driver::_setupChannels() {
+    _inputPorts = _sensorPorts = _outputPorts = 0;
+    auto input = [&]( int channel, Input::Kind kind, int type, int floor ) {
+        if ( channel == Layout::none )
+            return;
+        Input &in = _inputs[ channel >> 8 ][ channel & 0xff ];
+        in.kind = kind;
+        in.type = type;
+        in.floor = floor;
+        _inputMask.bits[ channel >> 8 ] |= 1u << ( channel & 0xff );
+        _inputPorts |= 1u << ( channel >> 8 );
+        if ( kind == Input::Sensor ) {
+            _sensorMask.bits[ channel >> 8 ] |= 1u << ( channel & 0xff );
+            _sensorPorts |= 1u << ( channel >> 8 );
+        }
+    };
+    auto output = [&]( int channel ) {
+        if ( channel != Layout::none )
+            _outputPorts |= 1u << ( channel >> 8 );
+    };
+
+    for ( int i = 0; i < _layout.floors(); ++i ) {
+        for ( int t = 0; t < 3; ++t ) {
+            input( _layout.buttons[ i ][ t ], Input::Button, t, i );
+            output( _layout.lamps[ i ][ t ] );
+        }
+        input( _layout.sensors[ i ], Input::Sensor, 0, i );
+    }
+    input( _layout.stop, Input::Stop, 0, 0 );
+    input( _layout.obstruction, Input::Obstruction, 0, 0 );
+    for ( int ch : { _layout.stopLamp, _layout.doorOpen, _layout.motorDirection } )
+        output( ch );
+    for ( int ch : _layout.floorIndicator )
+        output( ch );
+}
+
+int Driver::_lamp( Button btn ) const {
+    assert_leq( _minFloor, btn.floor(), "out-of-bounds" );
+    assert_leq( btn.floor(), _maxFloor, "out-of-bounds" );
+    return _layout.lamps[ btn.floor() - _minFloor ][ int( btn.type() ) ];
+}
+
+int Driver::_button( Button btn ) const {
+    assert_leq( _minFloor, btn.floor(), "out-of-bounds" );
+    assert_leq( btn.floor(), _maxFloor, "out-of-bounds" );
+    return _layout.buttons[ btn.floor() - _minFloor ][ int( btn.type() ) ];
+}
+
 void Driver::init() {
     for ( int i = _minFloor; i <= _maxFloor; ++i ) {
         if ( i != _maxFloor )
@@ -59,6 +83,7 @@ void Driver::init() {
 
     setStopLamp( false );
     setDoorOpenLamp( false );
+    flush();
 }
 
 void Driver::shutdown() {
@@ -67,73 +92,120 @@ void Driver::shutdown() {
 }
 
 void Driver::setButtonLamp( Button btn, bool state ) {
-    _lio.io_set_bit( lamp( btn ), state );
+    _setOutput( _lamp( btn ), state );
 }
 
 void Driver::setStopLamp( bool state ) {
-    _lio.io_set_bit( LIGHT_STOP, state );
+    _setOutput( _layout.stopLamp, state );
 }
 
 void Driver::setDoorOpenLamp( bool state ) {
-    _lio.io_set_bit( DOOR_OPEN, state );
-
+    _setOutput( _layout.doorOpen, state );
 }
 
 void Driver::setFloorIndicator( int floor ) {
     assert_leq( _minFloor, floor, "floor out of bounds" );
     assert_leq( floor, _maxFloor, "floor out of bounds" );
-    --floor; // floor numers are from 0 in backend but from 1 in driver and labels
+    floor -= _minFloor; // floor numers are from 0 in backend
 
-    _lio.io_set_bit(FLOOR_IND1, (floor & 0x02) == 0x02 );
-    _lio.io_set_bit(FLOOR_IND2, (floor & 0x01) == 0x01 );
+    // binary encoded, MSB first
+    const auto &bits = _layout.floorIndicator;
+    for ( int i = 0, n = bits.size(); i < n; ++i )
+        _setOutput( bits[ i ], ( floor >> ( n - i - 1 ) ) & 1 );
 }
 
 bool Driver::getButtonLamp( Button button ) {
-    return _lio.io_read_bit( lamp( button ) );
+    return _getOutput( _lamp( button ) );
 }
 
 bool Driver::getStopLamp() {
-    return _lio.io_read_bit( LIGHT_STOP );
+    return _getOutput( _layout.stopLamp );
 }
 
 bool Driver::getDoorOpenLamp() {
-    return _lio.io_read_bit( DOOR_OPEN );
+    return _getOutput( _layout.doorOpen );
 }
 
 int Driver::getFloorIndicator() {
-    return ((_lio.io_read_bit( FLOOR_IND1 ) << 1) | (_lio.io_read_bit( FLOOR_IND2 ))) + 1;
+    int floor = 0;
+    for ( int ch : _layout.floorIndicator )
+        floor = ( floor << 1 ) | int( _getOutput( ch ) );
+    return floor + _minFloor;
 }
 
 bool Driver::getButtonSignal( Button btn ) {
-    return _lio.io_read_bit( button( btn ) );
+    return _lio.io_read_bit( _button( btn ) );
 }
 
 void Driver::setMotorSpeed( Direction direction, int speed ) {
     assert_lt( 0, speed, "Speed must be positive" );
     _lastDirection = direction;
-    _lio.io_set_bit( MOTORDIR, direction == Direction::Down );
-    _lio.io_write_analog( MOTOR, 2048 + 4 * speed );
+    _setOutput( _layout.motorDirection, direction == Direction::Down );
+    flush(); // direction must be set before motor is started
+    _lio.io_write_analog( _layout.motor, 2048 + 4 * speed );
 };
 
 void Driver::stopElevator() {
-    _lio.io_set_bit( MOTORDIR, _lastDirection == Direction::Up ); // reverse direction
-    _lio.io_write_analog( MOTOR, 0 ); // actually stop
+    _setOutput( _layout.motorDirection, _lastDirection == Direction::Up ); // reverse direction
+    flush();
+    _lio.io_write_analog( _layout.motor, 0 ); // actually stop
 };
 
 int Driver::getFloor() {
-    if ( _lio.io_read_bit( SENSOR1 ) )
-        return 1;
-    else if ( _lio.io_read_bit( SENSOR2 ) )
-        return 2;
-    else if ( _lio.io_read_bit( SENSOR3 ) )
-        return 3;
-    else if ( _lio.io_read_bit( SENSOR4 ) )
-        return 4;
-    else
-        return INT_MIN;
-
+    lowlevel::IO::Ports ports = _lio.io_read_ports( _sensorPorts );
+    for ( int p = 0; p < lowlevel::IO::Ports::count; ++p )
+        if ( uint32_t active = ports.bits[ p ] & _sensorMask.bits[ p ] )
+            return _inputs[ p ][ __builtin_ctz( active ) ].floor + _minFloor;
+    return INT_MIN;
 };
-bool Driver::getStop() { return _lio.io_read_bit( STOP );};
-bool Driver::getObstruction() { return _lio.io_read_bit( OBSTRUCTION ); };
+bool Driver::getStop() { return _lio.io_read_bit( _layout.stop );};
+bool Driver::getObstruction() { return _lio.io_read_bit( _layout.obstruction ); };
+
+void Driver::_setOutput( int channel, bool value ) {
+    if ( channel < 0 || _shadow.bit( channel ) == value )
+        return; // nonexistent channel or nothing to change
+    uint32_t bit = 1u << ( channel & 0xff );
+    _shadow.bits[ channel >> 8 ] ^= bit;
+    _dirty.bits[ channel >> 8 ] |= bit;
+}
+
+void Driver::flush() {
+    for ( int i = 0; i < lowlevel::IO::Ports::count; ++i )
+        if ( _dirty.bits[ i ] ) {
+            _lio.io_write_port( i, _dirty.bits[ i ], _shadow.bits[ i ] );
+            _dirty.bits[ i ] = 0;
+        }
+}
+
+InputFrame Driver::sample() {
+    lowlevel::IO::Ports ports = _lio.io_read_ports( _inputPorts );
+    InputFrame frame;
+    frame._minFloor = _minFloor;
+    for ( int p = 0; p < lowlevel::IO::Ports::count; ++p ) {
+        for ( uint32_t active = ports.bits[ p ] & _inputMask.bits[ p ];
+                active; active &= active - 1 )
+        {
+            const Input &in = _inputs[ p ][ __builtin_ctz( active ) ];
+            switch ( in.kind ) {
+                case Input::Button:
+                    frame._buttons[ in.type ][ in.floor >> 6 ] |= uint64_t( 1 ) << ( in.floor & 63 );
+                    break;
+                case Input::Sensor:
+                    if ( frame.floor == INT_MIN )
+                        frame.floor = in.floor + _minFloor;
+                    break;
+                case Input::Stop:
+                    frame.stop = true;
+                    break;
+                case Input::Obstruction:
+                    frame.obstruction = true;
+                    break;
+                case Input::None:
+                    assert_unreachable( "unmasked input" );
+            }
+        }
+    }
+    return frame;
+}
 
 }
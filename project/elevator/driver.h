@@ -3,8 +3,11 @@
 /** the middle level API for elevator */
 
 #include <tuple>
+#include <array>
 #include <cstdint>
+#include <climits>
 #include <elevator/io.h>
+#include <elevator/layout.h>
 
 #ifndef SRC_DRIVER_H
 #define SRC_DRIVER_H
@@ -25,8 +28,8 @@ struct Button {
 
     Tuple tuple() const { return std::make_tuple( int( _type ), _floor ); }
 
-    ButtonType type() { return _type; }
-    int floor() { return _floor; }
+    ButtonType type() const { return _type; }
+    int floor() const { return _floor; }
 
   private:
     ButtonType _type;
@@ -44,9 +47,33 @@ struct BasicDriverInfo {
     const int _maxFloor;
 };
 
+/* decoded values of all input channels read at once (see Driver::sample) */
+struct InputFrame {
+    InputFrame() : floor( INT_MIN ), stop( false ), obstruction( false ),
+        _minFloor( 0 ), _buttons()
+    { }
+
+    bool buttonSignal( Button btn ) const {
+        int i = btn.floor() - _minFloor;
+        return ( _buttons[ int( btn.type() ) ][ i >> 6 ] >> ( i & 63 ) ) & 1;
+    }
+
+    int floor; // INT_MIN if not at floor
+    bool stop;
+    bool obstruction;
+
+  private:
+    friend struct Driver;
+    int _minFloor;
+    // indexed by ButtonType, bit = floor - minFloor
+    uint64_t _buttons[ 3 ][ Layout::maxFloors / 64 ];
+};
+
 struct Driver : BasicDriverInfo {
 
-    Driver();
+    /* floors and channels are given by layout, device is passed to
+     * lowlevel::IO (nullptr means default device) */
+    explicit Driver( const Layout &layout = Layout::current(), const char *device = nullptr );
     ~Driver();
 
     /* initialize the elevator -- disable all lights and run to lowest floor */
@@ -69,6 +96,16 @@ struct Driver : BasicDriverInfo {
     bool getStop();
     bool getObstruction();
 
+    /* read all inputs at once (one device call per port), use this
+     * instead of separate get* calls if more inputs are needed */
+    InputFrame sample();
+
+    /* outputs (lamps, floor indicator) are not written to device
+     * immediately, driver keeps shadow copy of them and writes only
+     * changed ones at once when flush is called (motor control and
+     * init/shutdown flush themselves); lamp getters read the shadow copy */
+    void flush();
+
     int minFloor() const { return _minFloor; }
     int maxFloor() const { return _maxFloor; }
 
@@ -76,8 +113,32 @@ struct Driver : BasicDriverInfo {
 
 
   private:
+    // what is connected to input channel, precomputed from layout
+    struct Input {
+        enum Kind : uint8_t { None, Button, Sensor, Stop, Obstruction };
+        Input() : kind( None ), type( 0 ), floor( 0 ) { }
+        Kind kind;
+        uint8_t type; // ButtonType
+        uint16_t floor; // from 0
+    };
+
+    const Layout _layout;
     Direction _lastDirection;
     lowlevel::IO _lio;
+    lowlevel::IO::Ports _shadow; // last state of outputs
+    lowlevel::IO::Ports _dirty; // outputs changed since last flush
+    std::array< std::array< Input, 32 >, lowlevel::IO::Ports::count > _inputs;
+    lowlevel::IO::Ports _inputMask;
+    lowlevel::IO::Ports _sensorMask;
+    uint32_t _inputPorts;   // subdevices with any input
+    uint32_t _sensorPorts;  // subdevices with floor sensors
+    uint32_t _outputPorts;  // subdevices with any digital output
+
+    void _setupChannels();
+    int _lamp( Button ) const;
+    int _button( Button ) const;
+    void _setOutput( int channel, bool value );
+    bool _getOutput( int channel ) const { return _shadow.bit( channel ); }
 };
 
 }
@@ -18,26 +18,31 @@ struct TestDriver {
     Test lights() {
         Driver driver;
         driver.setStopLamp( true );
+        driver.flush();
         assert( driver.getStopLamp(), "driver feedback failure" );
         SLEEP;
         driver.setStopLamp( false );
 
         driver.setDoorOpenLamp( true );
+        driver.flush();
         assert( driver.getDoorOpenLamp(), "driver feedback failure" );
         SLEEP;
         driver.setDoorOpenLamp( false );
 
         for ( int i = 1; i <= 4; ++i ) {
             driver.setFloorIndicator( i );
+            driver.flush();
             SLEEP;
         }
 
         // we insert local function here which can access the driver
         auto _testButtonLamp = [&]( const Button btn ) {
             driver.setButtonLamp( btn, true );
+            driver.flush();
             assert( driver.getButtonLamp( btn ), "driver feedback failure" );
             SLEEP;
             driver.setButtonLamp( btn, false );
+            driver.flush();
         };
 
         for ( int i = 1; i < 4; ++i )
@@ -82,6 +87,7 @@ struct TestDriver {
 
         for ( auto b : buttons )
             driver.setButtonLamp( b, false );
+        driver.flush();
 
         std::cout << "Keep pressing lighted buttons" << std::endl;
         std::random_device rd;
@@ -90,6 +96,7 @@ struct TestDriver {
             SLEEP;
             Button b = buttons[ dist( rd ) ];
             driver.setButtonLamp( b, true );
+            driver.flush();
             assert( driver.getButtonLamp( b ), "lamp failed" );
             std::cout << "(" << int( b.type() ) << ", " << b.floor() << ")" << " ---> " << std::flush;
             Button b2 = getButton();
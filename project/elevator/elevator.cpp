@@ -22,17 +22,30 @@ Elevator::Elevator(
         int id,
         HeartBeat &heartbeat,
         ConcurrentQueue< Command > &inCommands,
-        ConcurrentQueue< StateChange > &outState
+        ConcurrentQueue< StateChange > &outState,
+        PollRate pollRate,
+        const char *device
     ) : _terminate( false ),
         _inCommands( inCommands ),
         _outState( outState ),
+        _driver( Layout::current(), device ),
         _heartbeat( heartbeat ),
         _previousDirection( Direction::None ),
         _lastStateUpdate( 0 ),
-        _floorButtons( genFloorButtons( _driver ) )
+        _pollRate( pollRate ),
+        _commandCount( 0 ),
+        _handledCommands( -1 ),
+        _floorButtons( genFloorButtons( _driver ) ),
+        _upRides( _driver.maxFloor() - _driver.minFloor() + 1 ),
+        _downRides( _driver.maxFloor() - _driver.minFloor() + 1 ),
+        _parkFloor( INT_MIN ),
+        _state( control::State::Normal )
 {
     _elevState.lastFloor = _driver.minFloor();
     _elevState.id = id;
+    _elevState.doorOpen = false;
+    for ( auto &t : _stateTime )
+        t.store( 0, std::memory_order_relaxed );
 }
 
 Elevator::~Elevator() {
@@ -76,7 +89,7 @@ Button buttonByDirection( Direction dir, int floor ) {
 }
 
 int Elevator::_updateAndGetFloor() {
-    int f = _driver.getFloor();
+    int f = _input.floor;
     if ( f != INT_MIN )
         _elevState.lastFloor = f;
     return f;
@@ -96,7 +109,7 @@ void Elevator::_startElevator() {
 void Elevator::_startElevator( Direction direction ) {
     _elevState.direction = direction;
     // we may not have current information in _elevState.lastFloor, on the other hand
-    // sensor never lies but may not know
+    // sensor (as sampled in this cycle) never lies but may not know
     _updateAndGetFloor(); // update information if sensor senses floor
     if ( _elevState.lastFloor == _driver.minFloor() )
         _elevState.direction = Direction::Up;
@@ -107,24 +120,24 @@ void Elevator::_startElevator( Direction direction ) {
         _elevState.direction = _optimalDirection();
     _driver.setMotorSpeed( _elevState.direction, _speed );
     _driver.setDoorOpenLamp( false );
+    _elevState.doorOpen = false;
 }
 
 Direction Elevator::_optimalDirection() const {
-    int lowerThan{ 0 }, higherThan { 0 };
     FloorSet floorsToServe = _elevState.insideButtons;
     if ( !floorsToServe.hasAny() ) {
         floorsToServe |= _elevState.upButtons;
         floorsToServe |= _elevState.downButtons;
     }
-    for ( int i = _driver.minFloor(); i <= _driver.maxFloor(); ++i ) {
-        if ( floorsToServe.get( i, _driver ) ) {
-            if ( i > _elevState.lastFloor )
-                ++higherThan;
-            if ( i < _elevState.lastFloor )
-                ++lowerThan;
-        }
-    }
-    return higherThan >= lowerThan ? Direction::Up : Direction::Down;
+    const int last = _elevState.lastFloor;
+    // floor not known yet (below/above all floors)
+    if ( last < _driver.minFloor() )
+        return Direction::Up;
+    if ( last > _driver.maxFloor() )
+        return floorsToServe.hasAny() ? Direction::Down : Direction::Up;
+
+    return floorsToServe.countHigher( last, _driver ) >= floorsToServe.countLower( last, _driver )
+        ? Direction::Up : Direction::Down;
 }
 
 /* we want to prioritize inside buttons, imagine:
@@ -148,7 +161,7 @@ void Elevator::_emitStateChange( ChangeType type, int floor ) {
     change.changeType = type;
     change.changeFloor = floor;
     _lastStateUpdate = change.state.timestamp = now();
-    _outState.enqueue( change );
+    _outState.enqueue( std::move( change ) );
 }
 
 void Elevator::_setButtonLampAndFlag( Button btn, bool val ) {
@@ -179,15 +192,32 @@ bool Elevator::_shouldStop( int currentFloor ) const {
      * the special case of topmost/bottommost floor need not to be
      * handled as elevator stops there anyway
      */
-    return   _elevState.insideButtons.get( currentFloor, _driver )
+    const FloorSet all = _allButtons();
+    if ( _elevState.insideButtons.get( currentFloor, _driver )
+        || ( currentFloor == _parkFloor && !all.hasAny() )
         || ( _elevState.direction == Direction::Up
                 && _elevState.upButtons.get( currentFloor, _driver ) )
         || ( _elevState.direction == Direction::Down
-                && _elevState.downButtons.get( currentFloor, _driver ) )
-        || ( _allButtons().get( currentFloor, _driver )
-                && ( !_allButtons().anyOther( currentFloor, _driver )
-                    || _allButtons() == _elevState.upButtons
-                    || _allButtons() == _elevState.downButtons) );
+                && _elevState.downButtons.get( currentFloor, _driver ) ) )
+        return true;
+
+    return all.get( currentFloor, _driver )
+        && ( all.count() == 1 // only this floor is requested
+            || all == _elevState.upButtons
+            || all == _elevState.downButtons
+            // moving car has nothing else to do in its direction
+            || ( _elevState.direction != Direction::None && !_requestedAhead( currentFloor ) ) );
+}
+
+/* anything to serve beyond floor in direction car moves (requests, or
+ * parking if there are none) */
+bool Elevator::_requestedAhead( int floor ) const {
+    const FloorSet all = _allButtons();
+    if ( _elevState.direction == Direction::Up )
+        return all.anyHigher( floor, _driver ) || ( _parkFloor != INT_MIN && _parkFloor > floor );
+    if ( _elevState.direction == Direction::Down )
+        return all.anyLower( floor, _driver ) || ( _parkFloor != INT_MIN && _parkFloor < floor );
+    return false;
 }
 
 void Elevator::_clearDirectionButtonLamp() {
@@ -225,6 +255,186 @@ void Elevator::_initializeElevator() {
     }
 }
 
+void Elevator::_handleCommand( const Command &command ) {
+    assert( command.targetElevatorId == _elevState.id
+            || command.targetElevatorId == Command::ANY_ID, "command to other elevator" );
+    ++_commandCount;
+    switch ( command.commandType ) {
+    case CommandType::Empty:
+        break;
+    case CommandType::CallToFloorAndGoUp:
+        _parkFloor = INT_MIN; // requests always take precedence
+        _elevState.upButtons.set( true, command.targetFloor, _driver );
+        _driver.setButtonLamp( Button{ ButtonType::CallUp, command.targetFloor }, true );
+        break;
+    case CommandType::CallToFloorAndGoDown:
+        _parkFloor = INT_MIN;
+        _elevState.downButtons.set( true, command.targetFloor, _driver );
+        _driver.setButtonLamp( Button{ ButtonType::CallDown, command.targetFloor }, true );
+        break;
+    case CommandType::TurnOnLightUp:
+        _driver.setButtonLamp( Button{ ButtonType::CallUp, command.targetFloor }, true );
+        break;
+    case CommandType::TurnOffLightUp:
+        _driver.setButtonLamp( Button{ ButtonType::CallUp, command.targetFloor }, false );
+        break;
+    case CommandType::TurnOnLightDown:
+        _driver.setButtonLamp( Button{ ButtonType::CallDown, command.targetFloor }, true );
+        break;
+    case CommandType::TurnOffLightDown:
+        _driver.setButtonLamp( Button{ ButtonType::CallDown, command.targetFloor }, false );
+        break;
+    case CommandType::CancelCallUp:
+        _elevState.upButtons.set( false, command.targetFloor, _driver );
+        break;
+    case CommandType::CancelCallDown:
+        _elevState.downButtons.set( false, command.targetFloor, _driver );
+        break;
+    case CommandType::DestinationCall: {
+        const DestinationCall call( command.targetFloor, command.destinationFloor );
+        _parkFloor = INT_MIN;
+        ( call.pickup().type() == ButtonType::CallUp
+            ? _elevState.upButtons : _elevState.downButtons ).set( true, call.origin, _driver );
+        ( call.pickup().type() == ButtonType::CallUp ? _upRides : _downRides )
+            [ call.origin - _driver.minFloor() ].set( true, call.destination, _driver );
+        _elevState.destinations.set( true, call.destination, _driver );
+        break;
+    }
+    case CommandType::ParkAt:
+        assert_leq( _driver.minFloor(), command.targetFloor, "park floor out of bounds" );
+        assert_leq( command.targetFloor, _driver.maxFloor(), "park floor out of bounds" );
+        _parkFloor = command.targetFloor;
+        break;
+    }
+}
+
+const Elevator::ActionFn Elevator::_actions[ control::actionCount ] = {
+    &Elevator::_onNone,
+    &Elevator::_onHalt,
+    &Elevator::_onResume,
+    &Elevator::_onArrive,
+    &Elevator::_onCloseDoor,
+    &Elevator::_onCloseDoorTimeout,
+    &Elevator::_onIdle
+};
+
+void Elevator::_dispatch( control::Event event, Cycle &cycle ) {
+    const control::Transition &t = control::dispatch( _state, event );
+    _state = t.next;
+    ( this->*_actions[ int( t.action ) ] )( cycle );
+}
+
+/* stop button will (surprise) stop the elevator right where it is
+ * movement is resumed once button is presses again */
+void Elevator::_onHalt( Cycle & ) {
+    _stopElevator();
+    _emitStateChange( ChangeType::OtherChange, _updateAndGetFloor() );
+}
+
+void Elevator::_onResume( Cycle & ) {
+    _startElevator( _previousDirection );
+    _emitStateChange( ChangeType::OtherChange, _updateAndGetFloor() );
+}
+
+// we arrived at floor which was scheduled for us
+void Elevator::_onArrive( Cycle &cycle ) {
+    // turn off button lights
+    _setButtonLampAndFlag( Button( ButtonType::TargetFloor, cycle.currentFloor ), false );
+    // open doors
+    _driver.setDoorOpenLamp( true );
+    _elevState.doorOpen = true;
+    cycle.doorWaitingStarted = now();
+    _stopElevator();
+    // this floor is served
+    _removeTargetFloor( cycle.currentFloor );
+    _boardRides( cycle.currentFloor );
+    if ( cycle.currentFloor == _parkFloor )
+        _parkFloor = INT_MIN;
+    _emitStateChange( ChangeType::Served, cycle.currentFloor );
+}
+
+/* direction in which car leaves floor it stands at: it keeps its previous
+ * direction while there is call in that direction at this floor or anything
+ * requested beyond, otherwise it serves call waiting at this floor */
+Direction Elevator::_departureDirection( int floor ) const {
+    const FloorSet all = _allButtons();
+    if ( _previousDirection == Direction::Up && ( _elevState.upButtons.get( floor, _driver )
+                || all.anyHigher( floor, _driver ) ) )
+        return Direction::Up;
+    if ( _previousDirection == Direction::Down && ( _elevState.downButtons.get( floor, _driver )
+                || all.anyLower( floor, _driver ) ) )
+        return Direction::Down;
+    if ( _elevState.upButtons.get( floor, _driver ) )
+        return Direction::Up;
+    if ( _elevState.downButtons.get( floor, _driver ) )
+        return Direction::Down;
+    return Direction::None;
+}
+
+// passengers waiting at floor for direction car leaves in board, their
+// destinations become targets
+void Elevator::_boardRides( int floor ) {
+    const Direction dir = _departureDirection( floor );
+    if ( dir == Direction::None )
+        return;
+    FloorSet &dests = ( dir == Direction::Up ? _upRides : _downRides )
+        [ floor - _driver.minFloor() ];
+    if ( !dests.hasAny() )
+        return;
+    for ( int f = dests.lowest( _driver ); f != INT_MIN; f = dests.nextHigher( f, _driver ) )
+        _setButtonLampAndFlag( Button( ButtonType::TargetFloor, f ), true );
+    dests.reset();
+    _elevState.destinations.reset();
+    for ( const auto &d : _upRides )
+        _elevState.destinations |= d;
+    for ( const auto &d : _downRides )
+        _elevState.destinations |= d;
+}
+
+void Elevator::_onCloseDoor( Cycle & ) {
+    _driver.setDoorOpenLamp( false );
+    _elevState.doorOpen = false;
+}
+
+void Elevator::_onCloseDoorTimeout( Cycle &cycle ) {
+    _onCloseDoor( cycle );
+    const int floor = cycle.currentFloor;
+    // passengers assigned while door was open board too, call stays for
+    // those who wait for the other direction
+    _boardRides( floor );
+    if ( !_upRides[ floor - _driver.minFloor() ].hasAny() ) {
+        _elevState.upButtons.set( false, floor, _driver );
+        _driver.setButtonLamp( Button{ ButtonType::CallUp, floor }, false );
+        _emitStateChange( ChangeType::ServedUp, floor );
+    }
+    if ( !_downRides[ floor - _driver.minFloor() ].hasAny() ) {
+        _elevState.downButtons.set( false, floor, _driver );
+        _driver.setButtonLamp( Button{ ButtonType::CallDown, floor }, false );
+        _emitStateChange( ChangeType::ServedDown, floor );
+    }
+}
+
+void Elevator::_onIdle( Cycle &cycle ) {
+    if ( _allButtons().hasAny() ) {
+        _parkFloor = INT_MIN;
+        // we are not moving but we can
+        if ( _priorityFloorsInDirection( _previousDirection ) )
+            _startElevator( _previousDirection );
+        else
+            _startElevator(); // decides which direction is better itself
+
+        _emitStateChange( ChangeType::OtherChange, cycle.currentFloor );
+    } else if ( _parkFloor != INT_MIN && cycle.currentFloor != INT_MIN ) {
+        if ( _parkFloor == cycle.currentFloor )
+            _parkFloor = INT_MIN; // already there
+        else {
+            _startElevator( _parkFloor > cycle.currentFloor ? Direction::Up : Direction::Down );
+            _emitStateChange( ChangeType::OtherChange, cycle.currentFloor );
+        }
+    }
+    _clearDirectionButtonLamp();
+}
+
 void Elevator::_loop() {
     // no matter whether exit is caused by terminate flag or exception
     // we want to stop elevator (ok, it works only for exceptions caught somewhere
@@ -232,35 +442,35 @@ void Elevator::_loop() {
     // restarting)
     auto d_stop = wibble::raii::defer( [&]() { _stopElevator(); } );
 
-    // for some buttons, we need to keep track about changes, so that we
-    // can detect button press/release event no just the fact that button
-    // is now activated
-    FloorSet inFloorButtons, inFloorButtonsLast;
+    Cycle cycle;
     bool stopLast{ false }, stopNow{ false };
 
     int prevFloor{ INT_MIN }; // to keep track when to send state update
 
-    MillisecondTime doorWaitingStarted{ 0 }; // for closing doors
-
-    enum class State { Normal, WaitingForInButton, Stopped };
-    State state = State::Normal;
-
+    _state = control::State::Normal;
     _initializeElevator();
     if ( _driver.getStopLamp() )
-        state = State::Stopped;
+        _state = control::State::Stopped;
 
+    MillisecondTime stateMark = now();
     while ( !_terminate.load( std::memory_order::memory_order_relaxed ) ) {
         // initialize cycle
-        inFloorButtonsLast = inFloorButtons;
-        inFloorButtons.reset();
+        const MillisecondTime cycleStart = now();
+        _stateTime[ int( _state ) ].fetch_add( cycleStart - stateMark, std::memory_order_relaxed );
+        stateMark = cycleStart;
+
+        _input = _driver.sample(); // all inputs at once
+        cycle.inFloorButtonsLast = cycle.inFloorButtons;
+        cycle.inFloorButtons.reset();
         stopLast = stopNow;
 
         assertConsistency();
 
         // handle buttons and lamps
         for ( auto b : _floorButtons ) {
-            if ( _driver.getButtonSignal( b ) ) {
+            if ( _input.buttonSignal( b ) ) {
                 if ( !_driver.getButtonLamp( b ) ) { // new press
+                    _parkFloor = INT_MIN;
                     _setButtonLampAndFlag( b, true );
                     if ( b.type() == ButtonType::TargetFloor ) {
                         // we need to serve this one on this elevator
@@ -273,74 +483,45 @@ void Elevator::_loop() {
                 // of detection re-pressing inside button to get elevator moving
                 // after entering
                 if ( b.type() == ButtonType::TargetFloor ) {
-                    inFloorButtons.set( true, b.floor(), _driver );
+                    cycle.inFloorButtons.set( true, b.floor(), _driver );
                 }
             }
         }
 
-        if ( (stopNow = _driver.getStop()) && stopNow != stopLast ) {
+        if ( (stopNow = _input.stop) && stopNow != stopLast ) {
             _elevState.stopped = !_driver.getStopLamp();
             _driver.setStopLamp( _elevState.stopped );
-
-            /* stop button will (surprise) stop the elevator right where it is
-             * movement is resumed once button is presses again */
-            if ( _elevState.stopped ) {
-                _stopElevator();
-                state = State::Stopped;
-                _emitStateChange( ChangeType::OtherChange, _updateAndGetFloor() );
-            } else {
-                _startElevator( _previousDirection );
-                state = State::Normal;
-                _emitStateChange( ChangeType::OtherChange, _updateAndGetFloor() );
-            }
+            _dispatch( _elevState.stopped ? control::Event::StopOn : control::Event::StopOff, cycle );
         }
 
-        if ( _driver.getObstruction() ) {
+        if ( _input.obstruction ) {
             _driver.shutdown();
             while ( _driver.getObstruction() ) {
                 /* obstruction causes infinite loop which it turn causes
                  * heartbeat timeout and terminates whole process */
+                sleepFor( _pollRate.idle );
             }
         }
 
-        // must be nonblocking
-        auto maybeCommand = _inCommands.tryDequeue();
-        if ( !maybeCommand.isNothing() ) {
-            auto command = maybeCommand.value();
-            assert( command.targetElevatorId == _elevState.id
-                    || command.targetElevatorId == Command::ANY_ID, "command to other elevator" );
-            switch ( command.commandType ) {
-            case CommandType::Empty:
-                break;
-            case CommandType::CallToFloorAndGoUp:
-                _elevState.upButtons.set( true, command.targetFloor, _driver );
-                _driver.setButtonLamp( Button{ ButtonType::CallUp, command.targetFloor }, true );
-                break;
-            case CommandType::CallToFloorAndGoDown:
-                _elevState.downButtons.set( true, command.targetFloor, _driver );
-                _driver.setButtonLamp( Button{ ButtonType::CallDown, command.targetFloor }, true );
-                break;
-            case CommandType::TurnOnLightUp:
-                _driver.setButtonLamp( Button{ ButtonType::CallUp, command.targetFloor }, true );
-                break;
-            case CommandType::TurnOffLightUp:
-                _driver.setButtonLamp( Button{ ButtonType::CallUp, command.targetFloor }, false );
-                break;
-            case CommandType::TurnOnLightDown:
-                _driver.setButtonLamp( Button{ ButtonType::CallDown, command.targetFloor }, true );
-                break;
-            case CommandType::TurnOffLightDown:
-                _driver.setButtonLamp( Button{ ButtonType::CallDown, command.targetFloor }, false );
-                break;
-            }
-        }
+        // must be nonblocking, the rest of commands is handled while
+        // waiting for next tick
+        Command command;
+        while ( _inCommands.tryDequeue( command ) )
+            _handleCommand( command );
 
-        int currentFloor = _updateAndGetFloor();
+        const int currentFloor = cycle.currentFloor = _updateAndGetFloor();
         // safety precautions
         if ( currentFloor == _driver.maxFloor() && _elevState.direction == Direction::Up )
             _stopElevator();
         if ( currentFloor == _driver.minFloor() && _elevState.direction == Direction::Down )
             _stopElevator();
+        // nothing to serve in direction of travel (parking was cancelled by
+        // request behind car), stop without opening door and let idle car
+        // turn to requests
+        if ( currentFloor != INT_MIN && _elevState.direction != Direction::None
+                && !_allButtons().get( currentFloor, _driver )
+                && !_requestedAhead( currentFloor ) )
+            _stopElevator();
 
         if ( currentFloor != INT_MIN )
             _driver.setFloorIndicator( currentFloor );
@@ -348,67 +529,36 @@ void Elevator::_loop() {
         if ( currentFloor != prevFloor )
             _emitStateChange( ChangeType::OtherChange, currentFloor );
 
-        // note: we are here working wich _floorsToServe shared atomic variable
-        // it can change between subsequent loads, but only this thread
-        // ever removes any floor from it, so there is nothing dangerous in this
-
-        // now do what is needed depending on state
-        if ( state == State::Normal ) {
-
-            // check if we arrived at any floor which was scheduled for us
-            if ( currentFloor != INT_MIN && _shouldStop( currentFloor ) ) {
-                // turn off button lights
-                _setButtonLampAndFlag( Button( ButtonType::TargetFloor, currentFloor ), false );
-                // open doors
-                _driver.setDoorOpenLamp( true );
-                state = State::WaitingForInButton;
-                doorWaitingStarted = now();
-                _stopElevator();
-                // this floor is served
-                _removeTargetFloor( currentFloor );
-                _emitStateChange( ChangeType::Served, currentFloor );
-            } else if ( _elevState.direction == Direction::None ) {
-                if ( _allButtons().hasAny() ) {
-                    // we are not moving but we can
-                    if ( _priorityFloorsInDirection( _previousDirection ) )
-                        _startElevator( _previousDirection );
-                    else
-                        _startElevator(); // decides which direction is better itself
-
-                    _emitStateChange( ChangeType::OtherChange, currentFloor );
-                }
-                _clearDirectionButtonLamp();
-            }
-
-        } else if ( state == State::WaitingForInButton ) {
-            bool timeout = (doorWaitingStarted + _waitThreshold) < now();
-            if ( FloorSet::hasAdditional( inFloorButtonsLast, inFloorButtons ) || timeout )
-            {
-                _driver.setDoorOpenLamp( false );
-                state = State::Normal;
-                if ( timeout ) {
-                    _elevState.downButtons.set( false, currentFloor, _driver );
-                    _elevState.upButtons.set( false, currentFloor, _driver );
-                    _driver.setButtonLamp( Button{ ButtonType::CallUp, currentFloor }, false );
-                    _driver.setButtonLamp( Button{ ButtonType::CallDown, currentFloor }, false );
-                    _emitStateChange( ChangeType::ServedUp, currentFloor );
-                    _emitStateChange( ChangeType::ServedDown, currentFloor );
-                }
-            }
-        } else if ( state == State::Stopped ) {
-            // nothing to do
-        } else {
-            assert_unreachable();
-        }
+        // now do what is needed depending on state: collect events and let
+        // state machine pick the one current state reacts to
+        using control::Event;
+        const control::EventMask active =
+              control::bit( Event::Arrived, currentFloor != INT_MIN && _shouldStop( currentFloor ) )
+            | control::bit( Event::DoorTimeout, cycle.doorWaitingStarted + _waitThreshold < now() )
+            | control::bit( Event::InButton,
+                    FloorSet::hasAdditional( cycle.inFloorButtonsLast, cycle.inFloorButtons ) )
+            | control::bit( Event::Idle, _elevState.direction == Direction::None );
+        _dispatch( control::select( _state, active ), cycle );
 
         if ( _lastStateUpdate + _keepAlive <= now() )
             _emitStateChange( ChangeType::KeepAlive, currentFloor );
 
+        _driver.flush(); // write all changed outputs at once
+
         // it is important to do heartbeat at the end so that we don't end up
         // beating even in case we are repeatedlay auto-restarted due to assertion
         // we don't need to care about beating too often, it is cheap and safe
+        _handledCommands.store( _commandCount, std::memory_order_release );
         _heartbeat.beat();
         prevFloor = currentFloor;
+
+        // sleep until next tick, command wakes us up immediately; poll faster
+        // while moving so that we don't miss floor sensor
+        MillisecondTime tick = _elevState.direction != Direction::None
+            ? _pollRate.moving : _pollRate.idle;
+        MillisecondTime wait = cycleStart + tick - now();
+        if ( _inCommands.timeoutDequeue( command, wait > 0 ? wait : 0 ) )
+            _handleCommand( command );
     }
 }
 
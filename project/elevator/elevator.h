@@ -8,10 +8,12 @@
 #include <elevator/command.h>
 #include <elevator/state.h>
 #include <elevator/floorset.h>
+#include <elevator/control.h>
 
 #include <atomic>
 #include <thread>
 #include <vector>
+#include <array>
 
 
 #ifndef SRC_ELEVATOR_H
@@ -20,12 +22,36 @@
 namespace elevator {
 
 struct Elevator {
-    Elevator( int, HeartBeat &, ConcurrentQueue< Command > &, ConcurrentQueue< StateChange > & );
+    /* how often sensors are polled (in milliseconds), loop sleeps between
+     * polls, while elevator moves it polls faster so that it does not miss
+     * floor sensor */
+    struct PollRate {
+        PollRate() : idle( 25 ), moving( 5 ) { }
+        PollRate( MillisecondTime idle, MillisecondTime moving ) :
+            idle( idle ), moving( moving )
+        { }
+        MillisecondTime idle;
+        MillisecondTime moving;
+    };
+
+    /* device selects hardware (see lowlevel::IO), nullptr means default */
+    Elevator( int, HeartBeat &, ConcurrentQueue< Command > &, ConcurrentQueue< StateChange > &,
+            PollRate = PollRate(), const char *device = nullptr );
     ~Elevator();
 
     /* spawn control loop thread and run elevator (non blocking) */
     void run();
     void terminate();
+    bool running() const { return _thread.joinable(); }
+
+    /** time at which control loop finished its last cycle */
+    MillisecondTime lastCycle() const { return _heartbeat.lastBeat(); }
+
+    /** number of commands handled by the end of last cycle, -1 before
+     * first cycle */
+    long handledCommands() const {
+        return _handledCommands.load( std::memory_order_acquire );
+    }
 
     void assertConsistency();
 
@@ -33,21 +59,61 @@ struct Elevator {
         return BasicDriverInfo( _driver );
     }
 
+    /** total time control loop spent in given state (in milliseconds) */
+    MillisecondTime timeIn( control::State s ) const {
+        return _stateTime[ int( s ) ].load( std::memory_order_relaxed );
+    }
+
   private:
+    // values which live for whole control loop, used by state actions
+    struct Cycle {
+        Cycle() : currentFloor( INT_MIN ), doorWaitingStarted( 0 ) { }
+        // for some buttons, we need to keep track about changes, so that we
+        // can detect button press/release event no just the fact that button
+        // is now activated
+        FloorSet inFloorButtons, inFloorButtonsLast;
+        int currentFloor;
+        MillisecondTime doorWaitingStarted; // for closing doors
+    };
+    using ActionFn = void (Elevator::*)( Cycle & );
+
     void _loop();
+    void _dispatch( control::Event, Cycle & );
 
     std::atomic< bool > _terminate;
     ConcurrentQueue< Command > &_inCommands;
     ConcurrentQueue< StateChange > &_outState;
     Driver _driver;
+    InputFrame _input; // sampled at beginning of each cycle
     HeartBeat &_heartbeat;
     std::thread _thread;
 
     ElevatorState _elevState;
     Direction _previousDirection;
     MillisecondTime _lastStateUpdate;
+    const PollRate _pollRate;
+    long _commandCount; // control loop only
+    std::atomic< long > _handledCommands; // published at end of cycle
 
     const std::vector< Button > _floorButtons;
+    // destination dispatch: destinations of passengers waiting at given
+    // floor (indexed from minFloor), separately by direction they go
+    std::vector< FloorSet > _upRides;
+    std::vector< FloorSet > _downRides;
+    int _parkFloor; // INT_MIN if not parking, dropped by any request
+
+    control::State _state;
+    std::array< std::atomic< MillisecondTime >, control::stateCount > _stateTime;
+    // indexed by control::Action
+    static const ActionFn _actions[ control::actionCount ];
+
+    void _onNone( Cycle & ) { }
+    void _onHalt( Cycle & );
+    void _onResume( Cycle & );
+    void _onArrive( Cycle & );
+    void _onCloseDoor( Cycle & );
+    void _onCloseDoorTimeout( Cycle & );
+    void _onIdle( Cycle & );
 
     void _addTargetFloor( int floor );
     void _removeTargetFloor( int floor );
@@ -59,9 +125,13 @@ struct Elevator {
     Direction _optimalDirection() const;
     bool _priorityFloorsInDirection( Direction ) const;
     void _emitStateChange( ChangeType, int );
+    void _handleCommand( const Command & );
     FloorSet _allButtons() const;
     bool _shouldStop( int ) const;
+    bool _requestedAhead( int ) const;
     void _clearDirectionButtonLamp();
+    Direction _departureDirection( int floor ) const;
+    void _boardRides( int floor );
     void _initializeElevator();
 
     static constexpr MillisecondTime _speed = 300;
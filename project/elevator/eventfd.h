@@ -0,0 +1,47 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <cstdint>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include <elevator/test.h>
+
+/* RAII wrapper for linux eventfd, used as pollable notification which can be
+ * waited for together with sockets (see Poller)
+ */
+
+#ifndef SRC_EVENTFD_H
+#define SRC_EVENTFD_H
+
+namespace elevator {
+
+struct EventFd {
+    EventFd() : _fd( eventfd( 0, EFD_NONBLOCK | EFD_CLOEXEC ) ) {
+        assert_leq( 0, _fd, "eventfd creation failed" );
+    }
+    EventFd( const EventFd & ) = delete;
+    ~EventFd() { close( _fd ); }
+
+    /** make descriptor readable */
+    void signal() {
+        uint64_t one = 1;
+        int rc = write( _fd, &one, sizeof( one ) );
+        static_cast< void >( rc ); // can fail only on counter overflow
+    }
+
+    /** make descriptor non-readable again */
+    void clear() {
+        uint64_t val;
+        int rc = read( _fd, &val, sizeof( val ) );
+        static_cast< void >( rc ); // EAGAIN if not signalled
+    }
+
+    int fd() const { return _fd; }
+
+  private:
+    int _fd;
+};
+
+}
+
+#endif // SRC_EVENTFD_H
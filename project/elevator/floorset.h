@@ -1,15 +1,23 @@
 #include <elevator/driver.h>
+#include <elevator/test.h>
 #include <cstdint>
-#include <atomic>
+#include <climits>
 #include <tuple>
+#include <array>
+#include <vector>
 
 /* Simple abstraction over set of floors
  * requires elevator driver to detect minimal and maximal foor
  * uses user defined indices (those that are on hardware), not zero based
- * can handle up to 64 floors
+ *
+ * Set is a fixed array of 64bit words, operations on whole sets work on all
+ * words at once (loops over fixed number of words with no data dependent
+ * branches, which compiler unrolls/vectorizes), queries relative to floor
+ * scan only words on the given side of the floor.
  *
  * The type is serializable, but does not provide type tag,
- * so it can be serialized only as part of tagged type
+ * so it can be serialized only as part of tagged type, only non-zero words
+ * are serialized (together with mask of non-zero words)
  */
 
 #ifndef SRC_FLOOR_SET_H
@@ -17,69 +25,153 @@
 
 namespace elevator {
 
-struct FloorSet {
-    FloorSet() : _floors( 0 ) { }
-    explicit FloorSet( std::tuple< uint64_t > t ) : _floors( std::get< 0 >( t ) ) { }
-    std::tuple< uint64_t > tuple() const { return std::make_tuple( _floors ); }
+template< size_t Words >
+struct BasicFloorSet {
+    static_assert( Words > 0 && Words <= 64, "word mask must fit in 64 bits" );
+    static const int maxFloors = Words * 64;
+
+    // ( mask of non-zero words, non-zero words )
+    using Tuple = std::tuple< uint64_t, std::vector< uint64_t > >;
+
+    BasicFloorSet() : _words() { }
+    explicit BasicFloorSet( const Tuple &t ) : _words() {
+        const std::vector< uint64_t > &words = std::get< 1 >( t );
+        auto it = words.begin();
+        for ( uint64_t mask = std::get< 0 >( t ); mask; mask &= mask - 1 ) {
+            assert( it != words.end(), "corrupted floor set" );
+            _words[ __builtin_ctzll( mask ) ] = *it++;
+        }
+    }
+
+    Tuple tuple() const {
+        Tuple t;
+        for ( size_t w = 0; w < Words; ++w )
+            if ( _words[ w ] ) {
+                std::get< 0 >( t ) |= uint64_t( 1 ) << w;
+                std::get< 1 >( t ).push_back( _words[ w ] );
+            }
+        return t;
+    }
 
     bool get( int floor, const BasicDriverInfo &d ) const {
-        _checkBounds( floor, d );
-        return _floors & (1ul << (floor - d.minFloor()));
+        int i = _index( floor, d );
+        return _words[ i >> 6 ] & _bit( i );
     }
 
     bool set( bool value, int floor, const BasicDriverInfo &d ) {
         bool orig = get( floor, d );
+        int i = floor - d.minFloor();
         if ( value )
-            _floors |= 1ul << (floor - d.minFloor());
+            _words[ i >> 6 ] |= _bit( i );
         else
-            _floors &= ~(1ul << (floor - d.minFloor()));
+            _words[ i >> 6 ] &= ~_bit( i );
         return orig;
     }
 
     bool anyHigher( int floor, const BasicDriverInfo &d ) const {
-        _checkBounds( floor, d );
-        return _floors & ( ~((1ul << (floor - d.minFloor())) - 1) << 1);
+        return nextHigher( floor, d ) != INT_MIN;
     }
 
     bool anyLower( int floor, const BasicDriverInfo &d ) const {
-        _checkBounds( floor, d );
-        return _floors & ((1ul << (floor - d.minFloor())) - 1);
+        return nextLower( floor, d ) != INT_MIN;
     }
 
     bool anyOther( int floor, const BasicDriverInfo &d ) const {
-        _checkBounds( floor, d );
-        return _floors & ~(1ul << (floor - d.minFloor()));
+        int i = _index( floor, d );
+        BasicFloorSet other = *this;
+        other._words[ i >> 6 ] &= ~_bit( i );
+        return other.hasAny();
+    }
+
+    /** lowest floor in set, INT_MIN if empty; with nextHigher iterates set:
+     * for ( int f = set.lowest( d ); f != INT_MIN; f = set.nextHigher( f, d ) ) */
+    int lowest( const BasicDriverInfo &d ) const {
+        return get( d.minFloor(), d ) ? d.minFloor() : nextHigher( d.minFloor(), d );
+    }
+
+    /** nearest floor above given floor which is in set, INT_MIN if none */
+    int nextHigher( int floor, const BasicDriverInfo &d ) const {
+        int i = _index( floor, d );
+        size_t w = i >> 6;
+        uint64_t word = _words[ w ] & _maskAbove( i, w );
+        while ( !word && ++w < Words )
+            word = _words[ w ];
+        return word ? int( w * 64 ) + __builtin_ctzll( word ) + d.minFloor() : INT_MIN;
+    }
+
+    /** nearest floor below given floor which is in set, INT_MIN if none */
+    int nextLower( int floor, const BasicDriverInfo &d ) const {
+        int i = _index( floor, d );
+        size_t w = i >> 6;
+        uint64_t word = _words[ w ] & _maskBelow( i, w );
+        while ( !word && w-- > 0 )
+            word = _words[ w ];
+        return word ? int( w * 64 ) + 63 - __builtin_clzll( word ) + d.minFloor() : INT_MIN;
+    }
+
+    /** number of floors in set */
+    int count() const { return _count(); }
+
+    /** number of floors in set above given floor */
+    int countHigher( int floor, const BasicDriverInfo &d ) const {
+        int i = _index( floor, d );
+        int c = 0;
+        for ( size_t w = 0; w < Words; ++w )
+            c += __builtin_popcountll( _words[ w ] & _maskAbove( i, w ) );
+        return c;
+    }
+
+    /** number of floors in set below given floor */
+    int countLower( int floor, const BasicDriverInfo &d ) const {
+        int i = _index( floor, d );
+        int c = 0;
+        for ( size_t w = 0; w < Words; ++w )
+            c += __builtin_popcountll( _words[ w ] & _maskBelow( i, w ) );
+        return c;
     }
 
     bool consistent( const BasicDriverInfo &d ) const {
         return !anyHigher( d.maxFloor(), d );
     }
 
-    void reset() { _floors = 0; }
+    void reset() { _words.fill( 0 ); }
 
-    bool hasAny() const { return _floors; }
+    bool hasAny() const {
+        uint64_t acc = 0;
+        for ( size_t w = 0; w < Words; ++w )
+            acc |= _words[ w ];
+        return acc;
+    }
 
-    static bool hasAdditional( FloorSet a, FloorSet b ) {
+    static bool hasAdditional( BasicFloorSet a, BasicFloorSet b ) {
         // calculate buttons which were pressed between a and b
         // xor means buttons which changed state, and filters only those
         // pressed now
-        return (a._floors ^ b._floors) & b._floors;
+        uint64_t acc = 0;
+        for ( size_t w = 0; w < Words; ++w )
+            acc |= ( a._words[ w ] ^ b._words[ w ] ) & b._words[ w ];
+        return acc;
     }
 
-    FloorSet operator|=( FloorSet o ) {
-        return FloorSet( _floors |= o._floors );
+    BasicFloorSet operator|=( BasicFloorSet o ) {
+        for ( size_t w = 0; w < Words; ++w )
+            _words[ w ] |= o._words[ w ];
+        return *this;
     }
 
-    friend FloorSet operator|( FloorSet a, FloorSet b ) {
-        return FloorSet( a._floors | b._floors );
+    friend BasicFloorSet operator|( BasicFloorSet a, BasicFloorSet b ) {
+        return a |= b;
     }
 
-    friend bool operator==( FloorSet a, FloorSet b ) {
-        return a._floors == b._floors;
+    friend bool operator==( const BasicFloorSet &a, const BasicFloorSet &b ) {
+        uint64_t acc = 0;
+        for ( size_t w = 0; w < Words; ++w )
+            acc |= a._words[ w ] ^ b._words[ w ];
+        return !acc;
     }
 
-    friend bool operator!=( FloorSet a, FloorSet b ) {
-        return a._floors != b._floors;
+    friend bool operator!=( const BasicFloorSet &a, const BasicFloorSet &b ) {
+        return !( a == b );
     }
 
   private:
@@ -87,9 +179,79 @@ struct FloorSet {
         assert_leq( d.minFloor(), floor, "out-of-bounds floor (minimun)" );
         assert_leq( floor, d.maxFloor(), "out-of-bounds floor (maximum)" );
     }
-    uint64_t _floors;
+    static int _index( int floor, const BasicDriverInfo &d ) {
+        _checkBounds( floor, d );
+        return floor - d.minFloor();
+    }
+    static uint64_t _bit( int i ) { return uint64_t( 1 ) << ( i & 63 ); }
+
+    // bits of word w which correspond to indices above/below index i
+    static uint64_t _maskAbove( int i, size_t w ) {
+        size_t wi = i >> 6;
+        return w < wi ? 0 : w > wi ? ~uint64_t( 0 ) : ~( ( _bit( i ) << 1 ) - 1 );
+    }
+    static uint64_t _maskBelow( int i, size_t w ) {
+        size_t wi = i >> 6;
+        return w > wi ? 0 : w < wi ? ~uint64_t( 0 ) : _bit( i ) - 1;
+    }
+
+    int _count() const {
+        int c = 0;
+        for ( size_t w = 0; w < Words; ++w )
+            c += __builtin_popcountll( _words[ w ] );
+        return c;
+    }
+
+    std::array< uint64_t, Words > _words;
+
+    friend struct FloorCounts;
+};
+
+template< size_t Words >
+const int BasicFloorSet< Words >::maxFloors;
 
-    explicit FloorSet( uint64_t val ) : _floors( val ) { }
+using FloorSet = BasicFloorSet< Layout::maxFloors / 64 >;
+
+/* per-floor reference counts of floor sets, used to aggregate sets of many
+ * sources (elevators): each source reports change of its set and union of
+ * all sets is maintained in O(changed floors) and queried in O(1)
+ */
+struct FloorCounts {
+    FloorCounts() : _counts() { }
+
+    /** source which had set old now has set now */
+    void update( const FloorSet &old, const FloorSet &now ) {
+        for ( size_t w = 0; w < old._words.size(); ++w ) {
+            uint64_t added = now._words[ w ] & ~old._words[ w ];
+            uint64_t removed = old._words[ w ] & ~now._words[ w ];
+            for ( ; added; added &= added - 1 ) {
+                int i = w * 64 + __builtin_ctzll( added );
+                if ( _counts[ i ]++ == 0 )
+                    _nonzero._words[ w ] |= FloorSet::_bit( i );
+            }
+            for ( ; removed; removed &= removed - 1 ) {
+                int i = w * 64 + __builtin_ctzll( removed );
+                assert_lt( 0u, _counts[ i ], "floor count underflow" );
+                if ( --_counts[ i ] == 0 )
+                    _nonzero._words[ w ] &= ~FloorSet::_bit( i );
+            }
+        }
+    }
+
+    void add( const FloorSet &set ) { update( FloorSet(), set ); }
+    void remove( const FloorSet &set ) { update( set, FloorSet() ); }
+
+    /** floors with non-zero count */
+    FloorSet floors() const { return _nonzero; }
+
+    unsigned count( int floor, const BasicDriverInfo &d ) const {
+        FloorSet::_checkBounds( floor, d );
+        return _counts[ floor - d.minFloor() ];
+    }
+
+  private:
+    std::array< unsigned, FloorSet::maxFloors > _counts;
+    FloorSet _nonzero;
 };
 
 }
@@ -0,0 +1,75 @@
+#include <elevator/floorset.h>
+#include <elevator/serialization.h>
+#include <elevator/test.h>
+#include <climits>
+
+using namespace elevator;
+
+struct TestFloorSet {
+
+    Test basic() {
+        BasicDriverInfo bi{ 1, 4 };
+        FloorSet fs;
+        assert( !fs.hasAny(), "empty" );
+        assert( !fs.set( true, 3, bi ), "was not set" );
+        assert( fs.get( 3, bi ), "set" );
+        assert( fs.anyHigher( 2, bi ), "higher" );
+        assert( !fs.anyHigher( 3, bi ), "not higher" );
+        assert( fs.anyLower( 4, bi ), "lower" );
+        assert( !fs.anyLower( 3, bi ), "not lower" );
+        assert( fs.anyOther( 1, bi ), "other" );
+        assert( !fs.anyOther( 3, bi ), "not other" );
+        assert( fs.consistent( bi ), "consistent" );
+        assert( fs.set( false, 3, bi ), "was set" );
+        assert( !fs.hasAny(), "empty again" );
+    }
+
+    Test wide() {
+        BasicDriverInfo bi{ 1, FloorSet::maxFloors };
+        FloorSet a, b;
+        a.set( true, 1, bi );
+        a.set( true, 64, bi );
+        a.set( true, 65, bi );
+        a.set( true, FloorSet::maxFloors, bi );
+        assert_eq( a.count(), 4, "count" );
+        assert_eq( a.nextHigher( 1, bi ), 64, "next higher in same word" );
+        assert_eq( a.nextHigher( 65, bi ), FloorSet::maxFloors, "next higher across words" );
+        assert_eq( a.nextHigher( FloorSet::maxFloors, bi ), INT_MIN, "no higher" );
+        assert_eq( a.nextLower( 64, bi ), 1, "next lower" );
+        assert_eq( a.nextLower( FloorSet::maxFloors, bi ), 65, "next lower across words" );
+        assert_eq( a.nextLower( 1, bi ), INT_MIN, "no lower" );
+        assert( a.anyOther( 65, bi ), "other" );
+        assert_eq( a.countHigher( 1, bi ), 3, "count higher" );
+        assert_eq( a.countHigher( 64, bi ), 2, "count higher across words" );
+        assert_eq( a.countLower( 65, bi ), 2, "count lower" );
+        assert_eq( a.countLower( FloorSet::maxFloors, bi ), 3, "count lower across words" );
+        assert_eq( a.countLower( 1, bi ), 0, "none lower" );
+
+        b.set( true, 65, bi );
+        assert( !FloorSet::hasAdditional( a, b ), "no additional" );
+        b.set( true, 100, bi );
+        assert( FloorSet::hasAdditional( a, b ), "additional" );
+        assert_eq( ( a | b ).count(), 5, "union" );
+        assert( a != b, "different" );
+        b = a;
+        assert( a == b, "same" );
+    }
+
+    Test serialize() {
+        BasicDriverInfo bi{ 1, FloorSet::maxFloors };
+        FloorSet fs;
+        using S = serialization::Serializable< FloorSet >;
+        const long empty = S::size( fs );
+        fs.set( true, 2, bi );
+        fs.set( true, 3, bi );
+        assert_eq( S::size( fs ), long( empty + sizeof( uint64_t ) ), "one word" );
+        fs.set( true, FloorSet::maxFloors - 1, bi );
+        assert_eq( S::size( fs ), long( empty + 2 * sizeof( uint64_t ) ), "two words" );
+
+        char buf[ 64 ];
+        char *ptr = buf;
+        S::serialize( fs, &ptr );
+        const char *rptr = buf;
+        assert( S::deserialize( &rptr ) == fs, "round trip" );
+    }
+};
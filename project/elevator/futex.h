@@ -0,0 +1,104 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <atomic>
+#include <cstdint>
+#include <climits>
+#include <ctime>
+#include <chrono>
+
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+
+#include <elevator/time.h>
+
+/* thin wrapper around linux futex syscall and simple parking primitive
+ * built on top of it
+ *
+ * Parker is meant for lock-free data structures which need to block
+ * sometimes: fast path never touches it except for one load of waiter
+ * count, threads which want to sleep announce it by prepare(), re-check
+ * their condition and then either cancel() or park()
+ */
+
+#ifndef SRC_FUTEX_H
+#define SRC_FUTEX_H
+
+namespace elevator {
+
+struct Futex {
+    static_assert( sizeof( std::atomic< uint32_t > ) == sizeof( uint32_t ),
+            "atomic< uint32_t > is not usable as futex word" );
+
+    /** sleep if word still contains expected value, timeout (in real
+     * time) < 0 means wait forever, spurious wakeups are possible
+     */
+    static void wait( std::atomic< uint32_t > &word, uint32_t expected,
+            std::chrono::microseconds timeout = std::chrono::microseconds( -1 ) )
+    {
+        struct timespec ts;
+        struct timespec *tsp = nullptr;
+        if ( timeout.count() >= 0 ) {
+            ts.tv_sec = timeout.count() / 1000000;
+            ts.tv_nsec = (timeout.count() % 1000000) * 1000;
+            tsp = &ts;
+        }
+        syscall( SYS_futex, reinterpret_cast< uint32_t * >( &word ),
+                FUTEX_WAIT_PRIVATE, expected, tsp, nullptr, 0 );
+    }
+
+    static void wake( std::atomic< uint32_t > &word, int count = 1 ) {
+        syscall( SYS_futex, reinterpret_cast< uint32_t * >( &word ),
+                FUTEX_WAKE_PRIVATE, count, nullptr, nullptr, 0 );
+    }
+};
+
+struct Parker {
+    Parker() : _word( 0 ), _waiters( 0 ) { }
+    Parker( const Parker & ) = delete;
+
+    /** announce we are going to sleep, caller must re-check its condition
+     * after this and call either park (with returned ticket) or cancel
+     */
+    uint32_t prepare() {
+        _waiters.fetch_add( 1, std::memory_order_seq_cst );
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        return _word.load( std::memory_order_seq_cst );
+    }
+
+    void cancel() {
+        _waiters.fetch_sub( 1, std::memory_order_relaxed );
+    }
+
+    /** sleep until unpark is called (or timeout elapses), callers must
+     * handle spurious wakeups
+     */
+    void park( uint32_t ticket,
+            std::chrono::microseconds timeout = std::chrono::microseconds( -1 ) )
+    {
+        Futex::wait( _word, ticket, timeout );
+        _waiters.fetch_sub( 1, std::memory_order_relaxed );
+    }
+
+    /** wake up to count sleeping threads, this is cheap if nobody waits
+     * (one fence and load), must be called after change which could
+     * satisfy condition of waiters was published
+     */
+    void unpark( int count = 1 ) {
+        std::atomic_thread_fence( std::memory_order_seq_cst );
+        if ( _waiters.load( std::memory_order_relaxed ) > 0 ) {
+            _word.fetch_add( 1, std::memory_order_seq_cst );
+            Futex::wake( _word, count );
+        }
+    }
+
+    void unparkAll() { unpark( INT_MAX ); }
+
+  private:
+    std::atomic< uint32_t > _word;
+    std::atomic< int > _waiters;
+};
+
+}
+
+#endif // SRC_FUTEX_H
@@ -36,7 +36,7 @@ struct HeartBeatException : std::exception {
  * you have to make sure first beat will happen before first check */
 struct HeartBeat {
 
-    HeartBeat( MillisecondTime threshold ) : _threshold( threshold ) { }
+    HeartBeat( MillisecondTime threshold ) : _lastBeat( now() ), _threshold( threshold ) { }
     HeartBeat( const HeartBeat & ) = delete; // disable copying
 
     void beat() {
@@ -54,6 +54,7 @@ struct HeartBeat {
     }
 
     MillisecondTime threshold() const { return _threshold; }
+    MillisecondTime lastBeat() const { return _lastBeat.load( std::memory_order_acquire ); }
 
   private:
     std::atomic< MillisecondTime > _lastBeat;
@@ -101,12 +102,12 @@ struct HeartBeatManager {
 
     void runInThisThread() {
         while ( !terminate.load( std::memory_order::memory_order_relaxed ) ) {
-            auto next = std::chrono::steady_clock::now() + toSystemTime( rerunTime );
+            MillisecondTime next = now() + rerunTime;
 
             for ( auto &b : beats )
                 b.throwIfLate();
 
-            std::this_thread::sleep_until( next );
+            sleepFor( next - now() );
         }
     }
 
@@ -0,0 +1,204 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/** Lock-free ring buffers used as backends of ConcurrentQueue.
+ * They are non-blocking only, blocking (parking) is handled by the queue
+ * itself. Do not use directly, use ConcurrentQueue instead.
+ */
+
+#include <atomic>
+#include <memory>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <utility>
+
+#ifndef SRC_INTERNAL_RINGBUFFER_H
+#define SRC_INTERNAL_RINGBUFFER_H
+
+namespace elevator {
+namespace _internal {
+
+static constexpr size_t cacheLine = 64;
+
+static inline size_t roundUpToPowerOf2( size_t x ) {
+    size_t r = 1;
+    while ( r < x )
+        r <<= 1;
+    return r;
+}
+
+/* bounded multi-producer/multi-consumer ring, based on well known design
+ * of Dmitry Vyukov: each cell has its own sequence number which tells
+ * whether it is ready for writing (seq == pos) or reading (seq == pos + 1),
+ * producers and consumers only contend on their own position counter
+ */
+template< typename T >
+struct MPMCRing {
+
+    explicit MPMCRing( size_t capacity ) :
+        _mask( roundUpToPowerOf2( capacity < 2 ? 2 : capacity ) - 1 ),
+        _cells( new Cell[ _mask + 1 ] ),
+        _enqueuePos( 0 ), _dequeuePos( 0 )
+    {
+        for ( size_t i = 0; i <= _mask; ++i )
+            _cells[ i ].seq.store( i, std::memory_order_relaxed );
+    }
+
+    MPMCRing( const MPMCRing & ) = delete;
+
+    ~MPMCRing() {
+        // no concurrent access is possible now
+        size_t end = _enqueuePos.load( std::memory_order_acquire );
+        for ( size_t pos = _dequeuePos.load(); pos != end; ++pos )
+            reinterpret_cast< T * >( &_cells[ pos & _mask ].storage )->~T();
+    }
+
+    size_t capacity() const { return _mask + 1; }
+
+    /** construct element in place, arguments are not touched (moved from)
+     * if buffer is full */
+    template< typename... Args >
+    bool tryEmplace( Args &&...args ) {
+        Cell *cell = _acquire( _enqueuePos, 0 );
+        if ( !cell )
+            return false;
+        new ( &cell->storage ) T( std::forward< Args >( args )... );
+        cell->seq.store( cell->pos + 1, std::memory_order_release );
+        return true;
+    }
+
+    bool tryPop( T &out ) {
+        Cell *cell = _acquire( _dequeuePos, 1 );
+        if ( !cell )
+            return false;
+        T *ptr = reinterpret_cast< T * >( &cell->storage );
+        out = std::move( *ptr );
+        ptr->~T();
+        cell->seq.store( cell->pos + _mask + 1, std::memory_order_release );
+        return true;
+    }
+
+    /** not exact if there are concurrent modifications */
+    bool empty() const {
+        return _dequeuePos.load( std::memory_order_acquire )
+            >= _enqueuePos.load( std::memory_order_acquire );
+    }
+
+  private:
+    struct Cell {
+        std::atomic< size_t > seq;
+        size_t pos; // owned by thread which claimed cell
+        typename std::aligned_storage< sizeof( T ), alignof( T ) >::type storage;
+    };
+
+    /* claim cell for writing (offset = 0) or reading (offset = 1),
+     * returns nullptr if buffer is full/empty */
+    Cell *_acquire( std::atomic< size_t > &position, size_t offset ) {
+        size_t pos = position.load( std::memory_order_relaxed );
+        for ( ;; ) {
+            Cell *cell = &_cells[ pos & _mask ];
+            size_t seq = cell->seq.load( std::memory_order_acquire );
+            intptr_t diff = intptr_t( seq ) - intptr_t( pos + offset );
+            if ( diff == 0 ) {
+                if ( position.compare_exchange_weak( pos, pos + 1,
+                            std::memory_order_relaxed ) )
+                {
+                    cell->pos = pos;
+                    return cell;
+                }
+            } else if ( diff < 0 )
+                return nullptr;
+            else
+                pos = position.load( std::memory_order_relaxed );
+        }
+    }
+
+    const size_t _mask;
+    std::unique_ptr< Cell[] > _cells;
+    char _pad0[ cacheLine ];
+    std::atomic< size_t > _enqueuePos;
+    char _pad1[ cacheLine - sizeof( std::atomic< size_t > ) ];
+    std::atomic< size_t > _dequeuePos;
+    char _pad2[ cacheLine - sizeof( std::atomic< size_t > ) ];
+};
+
+/* bounded single-producer/single-consumer ring, push and pop are wait-free,
+ * each side keeps cached copy of the other side's index so in common case
+ * only its own index is touched (and both are on separate cache lines)
+ */
+template< typename T >
+struct SPSCRing {
+
+    explicit SPSCRing( size_t capacity ) :
+        _mask( roundUpToPowerOf2( capacity < 2 ? 2 : capacity ) - 1 ),
+        _cells( new Storage[ _mask + 1 ] ),
+        _tail( 0 ), _headCache( 0 ), _head( 0 ), _tailCache( 0 )
+    { }
+
+    SPSCRing( const SPSCRing & ) = delete;
+
+    ~SPSCRing() {
+        size_t end = _tail.load( std::memory_order_acquire );
+        for ( size_t pos = _head.load(); pos != end; ++pos )
+            _at( pos )->~T();
+    }
+
+    size_t capacity() const { return _mask + 1; }
+
+    // producer only, arguments are not touched (moved from) if buffer is full
+    template< typename... Args >
+    bool tryEmplace( Args &&...args ) {
+        size_t tail = _tail.load( std::memory_order_relaxed );
+        if ( tail - _headCache > _mask ) {
+            _headCache = _head.load( std::memory_order_acquire );
+            if ( tail - _headCache > _mask )
+                return false;
+        }
+        new ( _at( tail ) ) T( std::forward< Args >( args )... );
+        _tail.store( tail + 1, std::memory_order_release );
+        return true;
+    }
+
+    // consumer only
+    bool tryPop( T &out ) {
+        size_t head = _head.load( std::memory_order_relaxed );
+        if ( head == _tailCache ) {
+            _tailCache = _tail.load( std::memory_order_acquire );
+            if ( head == _tailCache )
+                return false;
+        }
+        T *ptr = _at( head );
+        out = std::move( *ptr );
+        ptr->~T();
+        _head.store( head + 1, std::memory_order_release );
+        return true;
+    }
+
+    /** not exact if there are concurrent modifications */
+    bool empty() const {
+        return _head.load( std::memory_order_acquire )
+            >= _tail.load( std::memory_order_acquire );
+    }
+
+  private:
+    using Storage = typename std::aligned_storage< sizeof( T ), alignof( T ) >::type;
+
+    T *_at( size_t pos ) { return reinterpret_cast< T * >( &_cells[ pos & _mask ] ); }
+
+    const size_t _mask;
+    std::unique_ptr< Storage[] > _cells;
+    char _pad0[ cacheLine ];
+    // producer's cache line
+    std::atomic< size_t > _tail;
+    size_t _headCache;
+    char _pad1[ cacheLine - sizeof( std::atomic< size_t > ) - sizeof( size_t ) ];
+    // consumer's cache line
+    std::atomic< size_t > _head;
+    size_t _tailCache;
+    char _pad2[ cacheLine - sizeof( std::atomic< size_t > ) - sizeof( size_t ) ];
+};
+
+}
+}
+
+#endif // SRC_INTERNAL_RINGBUFFER_H
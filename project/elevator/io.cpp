@@ -77,18 +77,42 @@ int lowlevel::IO::io_read_analog( int channel ) {
     return int( data );
 }
 
+
+
+lowlevel::IO::Ports lowlevel::IO::io_read_ports( uint32_t subdevices ) {
+    Ports ports;
+    for ( int subdev = 0; subdev < Ports::count; ++subdev ) {
+        if ( !( ( subdevices >> subdev ) & 1 ) )
+            continue;
+        unsigned int data = 0;
+        int rc = comedi_dio_bitfield2(_comediHandle, subdev, 0, &data, 0);
+        //assert_leq( 0, rc, "Comedi failure" );
+        ports.bits[ subdev ] = data;
+    }
+    return ports;
+}
+
+
+
+void lowlevel::IO::io_write_port( int subdevice, uint32_t mask, uint32_t bits ) {
+    unsigned int data = bits;
+    int rc = comedi_dio_bitfield2(_comediHandle, subdevice, mask, &data, 0);
+    //assert_leq( 0, rc, "Comedi failure" );
+}
+
 #else // O_HAVE_LIBCOMEDI
 
-#warning Using fake comedi library binding
+#warning Using simulated elevator instead of comedi library binding
 
-#include <map>
+#include <elevator/simulator.h>
 
+// simulated device, shared by all IO instances with same device name
 struct comedi_t_struct {
-    std::map< int, bool > setBits;
+    lowlevel::Simulator *sim;
 };
 
-lowlevel::IO::IO( const char * ) {
-    _comediHandle = new comedi_t();
+lowlevel::IO::IO( const char *device ) {
+    _comediHandle = new comedi_t{ &Simulator::device( device ? device : "/dev/comedi0" ) };
 }
 
 lowlevel::IO::~IO() {
@@ -96,21 +120,19 @@ lowlevel::IO::~IO() {
 }
 
 void lowlevel::IO::io_set_bit( int channel, bool value ) {
-    _comediHandle->setBits[ channel ] = value;
+    _comediHandle->sim->writeBit( channel, value );
 }
 
 
+
 void lowlevel::IO::io_write_analog( int channel, int value ) {
-    std::cout << "write analog, channel " << channel << " value " << value << std::endl;
+    _comediHandle->sim->writeAnalog( channel, value );
 }
 
 
 
 bool lowlevel::IO::io_read_bit( int channel ) {
-    auto it = _comediHandle->setBits.find( channel );
-    return it != _comediHandle->setBits.end()
-        ? it->second
-        : false;
+    return _comediHandle->sim->readBit( channel );
 }
 
 
@@ -119,6 +141,22 @@ int lowlevel::IO::io_read_analog( int /* channel */ ) {
     assert_unimplemented();
 }
 
+
+
+lowlevel::IO::Ports lowlevel::IO::io_read_ports( uint32_t subdevices ) {
+    Ports ports = _comediHandle->sim->readPorts();
+    for ( int i = 0; i < Ports::count; ++i )
+        if ( !( ( subdevices >> i ) & 1 ) )
+            ports.bits[ i ] = 0;
+    return ports;
+}
+
+
+
+void lowlevel::IO::io_write_port( int subdevice, uint32_t mask, uint32_t bits ) {
+    _comediHandle->sim->writePort( subdevice, mask, bits );
+}
+
 #endif // O_HAVE_LIBCOMEDI
 
 
@@ -16,6 +16,8 @@
 #ifndef __INCLUDE_IO_H__
 #define __INCLUDE_IO_H__
 
+#include <cstdint>
+
 // forward declare comedi_t, this is ugly because it depends on implementation
 // of libComedi, but it works
 struct comedi_t_struct;
@@ -25,6 +27,21 @@ namespace lowlevel {
 
 struct IO {
 
+    /**
+      Values of all digital channels read at once, indexed by channel
+      number same as for io_read_bit.
+    */
+    struct Ports {
+        Ports() : bits() { }
+
+        bool bit( int channel ) const {
+            return channel >= 0 && ( bits[ channel >> 8 ] >> ( channel & 0xff ) ) & 1;
+        }
+
+        static const int count = 32;
+        uint32_t bits[ count ]; // indexed by subdevice
+    };
+
     /**
       Initialize libComedi in "Sanntidssalen"
       @return Non-zero on success and 0 on failure
@@ -68,6 +85,26 @@ struct IO {
     */
     int io_read_analog(int channel);
 
+
+
+    /**
+      Reads digital ports at once (one device call per subdevice instead
+      of one per channel), outputs are read back as well.
+      @param subdevices Bit mask of subdevices to read.
+      @return Values of all digital channels of given subdevices.
+    */
+    Ports io_read_ports(uint32_t subdevices);
+
+
+
+    /**
+      Sets channels of digital subdevice selected by mask at once.
+      @param subdevice Subdevice (port) to write to (channel >> 8).
+      @param mask Channels to write (bit n is channel n of subdevice).
+      @param bits Values to write.
+    */
+    void io_write_port(int subdevice, uint32_t mask, uint32_t bits);
+
   private:
     comedi_t *_comediHandle;
 };
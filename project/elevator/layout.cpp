@@ -0,0 +1,202 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/layout.h>
+#include <elevator/channels.h>
+#include <elevator/io.h>
+#include <elevator/test.h>
+
+#include <fstream>
+#include <sstream>
+#include <memory>
+
+namespace elevator {
+
+const int Layout::none;
+const int Layout::maxFloors;
+
+Layout Layout::lab() {
+    Layout l;
+    l.minFloor = 1;
+    l.maxFloor = 4;
+    // { up, down, command }, same order as ButtonType
+    l.buttons = { { { FLOOR_UP1, FLOOR_DOWN1, FLOOR_COMMAND1 } },
+                  { { FLOOR_UP2, FLOOR_DOWN2, FLOOR_COMMAND2 } },
+                  { { FLOOR_UP3, FLOOR_DOWN3, FLOOR_COMMAND3 } },
+                  { { FLOOR_UP4, FLOOR_DOWN4, FLOOR_COMMAND4 } } };
+    l.lamps = { { { LIGHT_UP1, LIGHT_DOWN1, LIGHT_COMMAND1 } },
+                { { LIGHT_UP2, LIGHT_DOWN2, LIGHT_COMMAND2 } },
+                { { LIGHT_UP3, LIGHT_DOWN3, LIGHT_COMMAND3 } },
+                { { LIGHT_UP4, LIGHT_DOWN4, LIGHT_COMMAND4 } } };
+    l.sensors = { SENSOR1, SENSOR2, SENSOR3, SENSOR4 };
+    l.stop = STOP;
+    l.obstruction = OBSTRUCTION;
+    l.stopLamp = LIGHT_STOP;
+    l.doorOpen = DOOR_OPEN;
+    l.motor = MOTOR;
+    l.motorDirection = MOTORDIR;
+    l.floorIndicator = { FLOOR_IND1, FLOOR_IND2 };
+    return l;
+}
+
+Layout Layout::generate( int floors ) {
+    assert_leq( 2, floors, "building needs at least two floors" );
+    Layout l;
+    l.minFloor = 1;
+    l.maxFloor = floors;
+
+    // digital channels are allocated sequentially from subdevice 2 on
+    // (subdevice 1 is analog)
+    int next = 0;
+    auto alloc = [&]() {
+        int ch = ( ( 2 + next / 32 ) << 8 ) | ( next % 32 );
+        ++next;
+        return ch;
+    };
+
+    l.buttons.resize( floors );
+    l.lamps.resize( floors );
+    for ( int i = 0; i < floors; ++i ) {
+        l.buttons[ i ][ 0 ] = i < floors - 1 ? alloc() : none;
+        l.buttons[ i ][ 1 ] = i > 0 ? alloc() : none;
+        l.buttons[ i ][ 2 ] = alloc();
+        l.sensors.push_back( alloc() );
+    }
+    l.stop = alloc();
+    l.obstruction = alloc();
+    for ( int i = 0; i < floors; ++i ) {
+        l.lamps[ i ][ 0 ] = i < floors - 1 ? alloc() : none;
+        l.lamps[ i ][ 1 ] = i > 0 ? alloc() : none;
+        l.lamps[ i ][ 2 ] = alloc();
+    }
+    l.stopLamp = alloc();
+    l.doorOpen = alloc();
+    l.motorDirection = alloc();
+    while ( ( 1 << l.floorIndicator.size() ) < floors )
+        l.floorIndicator.push_back( alloc() );
+    l.motor = MOTOR;
+    l.assertConsistency();
+    return l;
+}
+
+static int buttonIndex( const std::string &type ) {
+    if ( type == "up" )
+        return 0;
+    if ( type == "down" )
+        return 1;
+    if ( type == "command" )
+        return 2;
+    assert_unreachable( "invalid button type in layout" );
+}
+
+Layout Layout::parse( std::istream &in ) {
+    Layout l;
+    for ( std::string line; std::getline( in, line ); ) {
+        line = line.substr( 0, line.find( '#' ) );
+        std::istringstream ls( line );
+        std::string key;
+        if ( !( ls >> key ) )
+            continue; // empty line
+
+        auto channel = [&]() -> int {
+            std::string ch;
+            assert( bool( ls >> ch ), "missing channel in layout" );
+            return std::stoi( ch, nullptr, 0 );
+        };
+        auto floorIndex = [&]() -> int {
+            int floor;
+            assert( bool( ls >> floor ), "missing floor in layout" );
+            assert( l.floors() > 0, "floors must be specified first in layout" );
+            assert_leq( l.minFloor, floor, "floor out of range in layout" );
+            assert_leq( floor, l.maxFloor, "floor out of range in layout" );
+            return floor - l.minFloor;
+        };
+
+        if ( key == "floors" ) {
+            assert( bool( ls >> l.minFloor >> l.maxFloor ), "invalid floors in layout" );
+            assert_lt( l.minFloor, l.maxFloor, "invalid floors in layout" );
+            std::array< int, 3 > empty{ { none, none, none } };
+            l.buttons.assign( l.floors(), empty );
+            l.lamps.assign( l.floors(), empty );
+            l.sensors.assign( l.floors(), none );
+        } else if ( key == "button" || key == "lamp" ) {
+            std::string type;
+            assert( bool( ls >> type ), "missing button type in layout" );
+            int t = buttonIndex( type );
+            int f = floorIndex();
+            ( key == "button" ? l.buttons : l.lamps )[ f ][ t ] = channel();
+        } else if ( key == "sensor" ) {
+            int f = floorIndex();
+            l.sensors[ f ] = channel();
+        } else if ( key == "stop" )
+            l.stop = channel();
+        else if ( key == "obstruction" )
+            l.obstruction = channel();
+        else if ( key == "stop-lamp" )
+            l.stopLamp = channel();
+        else if ( key == "door-open" )
+            l.doorOpen = channel();
+        else if ( key == "motor" )
+            l.motor = channel();
+        else if ( key == "motor-direction" )
+            l.motorDirection = channel();
+        else if ( key == "floor-indicator" ) {
+            l.floorIndicator.clear();
+            for ( std::string ch; ls >> ch; )
+                l.floorIndicator.push_back( std::stoi( ch, nullptr, 0 ) );
+        } else
+            assert_unreachable( "unknown key in layout" );
+    }
+    l.assertConsistency();
+    return l;
+}
+
+Layout Layout::load( const std::string &file ) {
+    std::ifstream in( file );
+    assert( in.good(), "could not open layout file" );
+    return parse( in );
+}
+
+static std::unique_ptr< Layout > &currentLayout() {
+    static std::unique_ptr< Layout > layout{ new Layout( Layout::lab() ) };
+    return layout;
+}
+
+const Layout &Layout::current() { return *currentLayout(); }
+
+void Layout::install( Layout layout ) {
+    layout.assertConsistency();
+    currentLayout().reset( new Layout( std::move( layout ) ) );
+}
+
+void Layout::assertConsistency() const {
+    auto digital = []( int ch ) {
+        return ch == none || ( ch >= 0 && ( ch >> 8 ) < lowlevel::IO::Ports::count
+                && ( ch & 0xff ) < 32 );
+    };
+
+    assert_lt( minFloor, maxFloor, "invalid floors" );
+    assert_leq( floors(), maxFloors, "too many floors" );
+    assert_eq( int( buttons.size() ), floors(), "buttons missing" );
+    assert_eq( int( lamps.size() ), floors(), "lamps missing" );
+    assert_eq( int( sensors.size() ), floors(), "sensors missing" );
+    for ( int i = 0; i < floors(); ++i ) {
+        assert_neq( sensors[ i ], none, "sensor missing" );
+        assert( digital( sensors[ i ] ), "invalid sensor channel" );
+        assert_neq( buttons[ i ][ 2 ], none, "command button missing" );
+        for ( int t = 0; t < 3; ++t ) {
+            assert( digital( buttons[ i ][ t ] ), "invalid button channel" );
+            assert( digital( lamps[ i ][ t ] ), "invalid lamp channel" );
+        }
+    }
+    for ( int ch : { stop, obstruction, stopLamp, doorOpen, motorDirection } ) {
+        assert_neq( ch, none, "channel missing" );
+        assert( digital( ch ), "invalid channel" );
+    }
+    assert_neq( motor, none, "motor channel missing" );
+    assert( !floorIndicator.empty(), "floor indicator missing" );
+    assert_leq( floors(), 1 << floorIndicator.size(), "not enough floor indicator bits" );
+    for ( int ch : floorIndicator )
+        assert( digital( ch ), "invalid floor indicator channel" );
+}
+
+}
@@ -0,0 +1,82 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Description of building geometry (floors) and of wiring of elevator
+ * hardware (which IO channel belongs to which button, lamp, sensor...)
+ *
+ * Default is layout of elevators in real-time lab (see channels.h), other
+ * layout can be loaded from text description and installed at startup
+ * before any Driver is created:
+ *
+ *     # comment
+ *     floors <min> <max>
+ *     button <up|down|command> <floor> <channel>
+ *     lamp <up|down|command> <floor> <channel>
+ *     sensor <floor> <channel>
+ *     stop <channel>
+ *     obstruction <channel>
+ *     stop-lamp <channel>
+ *     door-open <channel>
+ *     motor <channel>
+ *     motor-direction <channel>
+ *     floor-indicator <channel>...    # bits of binary floor index, MSB first
+ *
+ * channels are numbers as used by lowlevel::IO (subdevice << 8 | channel),
+ * hexadecimal numbers are accepted, buttons and lamps which are not
+ * present (up on top floor, down on bottom floor) are omitted
+ */
+
+#include <array>
+#include <vector>
+#include <string>
+#include <istream>
+
+#ifndef SRC_LAYOUT_H
+#define SRC_LAYOUT_H
+
+namespace elevator {
+
+struct Layout {
+    static const int none = -1; // channel which does not exist
+    static const int maxFloors = 128; // width of FloorSet
+
+    Layout() : minFloor( 0 ), maxFloor( -1 ), stop( none ), obstruction( none ),
+        stopLamp( none ), doorOpen( none ), motor( none ), motorDirection( none )
+    { }
+
+    int minFloor;
+    int maxFloor;
+    // per floor (from minFloor), indexed by ButtonType
+    std::vector< std::array< int, 3 > > buttons;
+    std::vector< std::array< int, 3 > > lamps;
+    std::vector< int > sensors;
+    int stop;
+    int obstruction;
+    int stopLamp;
+    int doorOpen;
+    int motor;
+    int motorDirection;
+    std::vector< int > floorIndicator; // MSB first
+
+    int floors() const { return maxFloor - minFloor + 1; }
+
+    /** layout of elevators in real-time lab */
+    static Layout lab();
+
+    /** synthetic layout for simulated building with given number of floors
+     * (numbered from 1) */
+    static Layout generate( int floors );
+
+    static Layout parse( std::istream & );
+    static Layout load( const std::string &file );
+
+    /** layout used by default constructed Driver */
+    static const Layout &current();
+    static void install( Layout );
+
+    /** asserts layout is complete and fits in IO channel space */
+    void assertConsistency() const;
+};
+
+}
+
+#endif // SRC_LAYOUT_H
@@ -0,0 +1,83 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/layout.h>
+#include <elevator/channels.h>
+#include <elevator/driver.h>
+#include <elevator/simulator.h>
+#include <elevator/test.h>
+#include <sstream>
+#include <thread>
+
+using namespace elevator;
+
+struct TestLayout {
+
+    Test lab() {
+        Layout l = Layout::lab();
+        l.assertConsistency();
+        assert_eq( l.floors(), 4, "lab floors" );
+        assert_eq( l.sensors[ 2 ], SENSOR3, "lab sensor" );
+        assert_eq( l.lamps[ 0 ][ 2 ], LIGHT_COMMAND1, "lab lamp" );
+    }
+
+    Test parse() {
+        std::istringstream in(
+                "# two floors\n"
+                "floors 0 1\n"
+                "button up 0 0x200\n"
+                "button command 0 0x201\n"
+                "button down 1 0x202\n"
+                "button command 1 0x203\n"
+                "sensor 0 0x204\n"
+                "sensor 1 0x205  # upper\n"
+                "stop 0x206\n"
+                "obstruction 0x207\n"
+                "lamp command 0 0x300\n"
+                "stop-lamp 0x301\n"
+                "door-open 0x302\n"
+                "motor-direction 0x303\n"
+                "floor-indicator 0x304\n"
+                "motor 0x100\n" );
+        Layout l = Layout::parse( in );
+        assert_eq( l.minFloor, 0, "min" );
+        assert_eq( l.maxFloor, 1, "max" );
+        assert_eq( l.buttons[ 0 ][ 0 ], 0x200, "button" );
+        assert_eq( l.buttons[ 0 ][ 1 ], Layout::none, "missing button" );
+        assert_eq( l.sensors[ 1 ], 0x205, "sensor" );
+        assert_eq( l.lamps[ 1 ][ 2 ], Layout::none, "missing lamp" );
+        assert_eq( l.motor, 0x100, "motor" );
+        assert_eq( int( l.floorIndicator.size() ), 1, "indicator" );
+    }
+
+    Test tallBuilding() {
+        Layout l = Layout::generate( 60 );
+        lowlevel::Simulator &sim = lowlevel::Simulator::device( "/dev/comedi0" );
+        lowlevel::Simulator::Config config;
+        config.timeScale = 20;
+        config.floorTime = 1;
+        config.startPosition = 57;
+        config.layout = l;
+        sim.reset( config );
+
+        Driver driver{ l };
+        assert_eq( driver.maxFloor(), 60, "floors" );
+        driver.setButtonLamp( Button( ButtonType::TargetFloor, 60 ), true );
+        driver.setFloorIndicator( 42 );
+        driver.flush();
+        assert( sim.output( l.lamps[ 59 ][ 2 ] ), "lamp" );
+        assert_eq( driver.getFloorIndicator(), 42, "indicator" );
+        assert_eq( driver.getFloor(), 58, "sensor" );
+
+        sim.pressButton( l.buttons[ 58 ][ 0 ] );
+        InputFrame frame = driver.sample();
+        assert( frame.buttonSignal( Button( ButtonType::CallUp, 59 ) ), "button" );
+        assert( !frame.buttonSignal( Button( ButtonType::CallUp, 58 ) ), "button" );
+
+        driver.setMotorSpeed( Direction::Up, 300 );
+        while ( driver.getFloor() != 60 )
+            std::this_thread::yield();
+        driver.stopElevator();
+        assert_eq( driver.sample().floor, 60, "sample" );
+        sim.reset();
+    }
+};
@@ -0,0 +1,55 @@
+#include <elevator/poller.h>
+#include <elevator/restartwrapper.h>
+#include <elevator/test.h>
+
+#include <unistd.h>
+#include <sys/epoll.h>
+
+namespace elevator {
+
+Poller::Poller() : _epoll( epoll_create1( EPOLL_CLOEXEC ) ), _terminate( false ) {
+    assert_leq( 0, _epoll, "epoll creation failed" );
+}
+
+Poller::~Poller() {
+    if ( _thr.joinable() )
+        terminate();
+    close( _epoll );
+}
+
+void Poller::add( int fd, Callback callback ) {
+    assert( !_thr.joinable(), "descriptors must be added before poller is run" );
+    auto it = _callbacks.emplace( fd, callback );
+    assert( it.second, "descriptor already added" );
+
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.ptr = &it.first->second;
+    int rc = epoll_ctl( _epoll, EPOLL_CTL_ADD, fd, &ev );
+    assert_eq( rc, 0, "epoll_ctl failed" );
+}
+
+int Poller::poll( long ms ) {
+    struct epoll_event events[ _maxEvents ];
+    int n = epoll_wait( _epoll, events, _maxEvents, int( ms ) );
+    for ( int i = 0; i < n; ++i )
+        ( *static_cast< Callback * >( events[ i ].data.ptr ) )();
+    return n < 0 ? 0 : n;
+}
+
+void Poller::run() {
+    _thr = std::thread( restartWrapper( &Poller::_loop ), this );
+}
+
+void Poller::terminate() {
+    assert( _thr.joinable(), "poller not running" );
+    _terminate = true;
+    _thr.join();
+}
+
+void Poller::_loop() {
+    while ( !_terminate.load( std::memory_order::memory_order_relaxed ) )
+        poll( _pollTimeout );
+}
+
+}
@@ -0,0 +1,52 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <functional>
+#include <map>
+#include <thread>
+#include <atomic>
+
+/* epoll based event loop, allows single thread to wait for any number of
+ * sockets and queues (using their notification descriptors) at once
+ * all descriptors must be added before loop is started (by run)
+ */
+
+#ifndef SRC_POLLER_H
+#define SRC_POLLER_H
+
+namespace elevator {
+
+struct Poller {
+    using Callback = std::function< void() >;
+
+    Poller();
+    Poller( const Poller & ) = delete;
+    ~Poller();
+
+    /** callback is called (in poller thread) whenever fd is readable,
+     * it should read all available data (poller is level-triggered)
+     */
+    void add( int fd, Callback callback );
+
+    /** wait for up to ms milliseconds for events and run callbacks,
+     * returns number of handled descriptors */
+    int poll( long ms );
+
+    /* spawn thread running poll in loop (non blocking) */
+    void run();
+    void terminate();
+
+  private:
+    int _epoll;
+    std::map< int, Callback > _callbacks;
+    std::thread _thr;
+    std::atomic< bool > _terminate;
+
+    void _loop();
+
+    static const int _maxEvents = 16;
+    static const long _pollTimeout = 100; // ms, to check termination
+};
+
+}
+
+#endif // SRC_POLLER_H
@@ -0,0 +1,100 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <thread>
+#include <vector>
+#include <iterator>
+
+#include <elevator/poller.h>
+#include <elevator/concurrentqueue.h>
+#include <elevator/udptools.h>
+#include <elevator/test.h>
+
+using namespace elevator;
+
+struct TestPoller {
+    Test empty() {
+        Poller poller;
+        assert_eq( poller.poll( 10 ), 0, "nothing to poll" );
+    }
+
+    void _queue( QueueBackend backend ) {
+        ConcurrentQueue< int > q{ backend, 64 };
+        std::vector< int > got;
+        Poller poller;
+        poller.add( q.enableNotifyFd(), [&]() {
+                q.acknowledgeNotify();
+                while ( q.dequeueBatch( std::back_inserter( got ), 8 ) )
+                { }
+            } );
+        assert_eq( poller.poll( 0 ), 0, "queue is empty" );
+        for ( int i = 0; i < 20; ++i )
+            q.enqueue( i );
+        assert_eq( poller.poll( 100 ), 1, "queue should be readable" );
+        assert_eq( got.size(), 20ul, "not all data received" );
+        assert_eq( poller.poll( 0 ), 0, "notification should be cleared" );
+
+        std::thread prod( [&]() {
+                for ( int i = 20; i < 1000; ++i )
+                    q.enqueue( i );
+            } );
+        while ( got.size() < 1000 )
+            poller.poll( 1000 );
+        prod.join();
+        for ( int i = 0; i < 1000; ++i )
+            assert_eq( got[ i ], i, "invalid data" );
+    }
+
+    Test queue() {
+        _queue( QueueBackend::Locked );
+        _queue( QueueBackend::LockFree );
+        _queue( QueueBackend::SPSC );
+    }
+
+    Test socketAndQueue() {
+        udp::Address addr{ udp::IPv4Address::localhost, udp::Port{ 64124 } };
+        udp::Socket rcv{ addr };
+        ConcurrentQueue< int > q{ QueueBackend::LockFree };
+        int packets = 0, elems = 0;
+
+        Poller poller;
+        poller.add( rcv.fd(), [&]() {
+                while ( rcv.recvPacketNonblocking().size() > 0 )
+                    ++packets;
+            } );
+        poller.add( q.enableNotifyFd(), [&]() {
+                q.acknowledgeNotify();
+                int x;
+                while ( q.tryDequeue( x ) )
+                    ++elems;
+            } );
+
+        udp::Socket snd{};
+        udp::Packet packet{ "Test", 5 };
+        packet.address() = addr;
+        assert( snd.sendPacket( packet ), "sending failed" );
+        q.enqueue( 1 );
+        while ( packets < 1 || elems < 1 )
+            assert_leq( 1, poller.poll( 1000 ), "timeout" );
+        assert_eq( packets, 1, "wrong packet count" );
+        assert_eq( elems, 1, "wrong element count" );
+    }
+
+    Test thread() {
+        ConcurrentQueue< int > q{ QueueBackend::SPSC };
+        std::atomic< int > sum{ 0 };
+        Poller poller;
+        poller.add( q.enableNotifyFd(), [&]() {
+                q.acknowledgeNotify();
+                int x;
+                while ( q.tryDequeue( x ) )
+                    sum += x;
+            } );
+        poller.run();
+        for ( int i = 1; i <= 100; ++i )
+            q.enqueue( i );
+        for ( int i = 0; i < 500 && sum != 5050; ++i )
+            std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        poller.terminate();
+        assert_eq( sum.load(), 5050, "not all data received" );
+    }
+};
@@ -1,23 +1,61 @@
 #include <elevator/scheduler.h>
 #include <elevator/restartwrapper.h>
+#include <vector>
+#include <iterator>
+#include <algorithm>
+#include <cstdlib>
 
 namespace elevator {
 
-Scheduler::Scheduler( int localId, HeartBeat &hb, BasicDriverInfo info,
+// adds CPU time spent in scope to scheduler statistics
+struct CpuTimer {
+    CpuTimer( std::atomic< long > &count, std::atomic< int64_t > &time, long n = 1 ) :
+        _count( count ), _time( time ), _n( n ), _start( threadCpuTime() )
+    { }
+    ~CpuTimer() {
+        _time.fetch_add( threadCpuTime() - _start, std::memory_order_relaxed );
+        _count.fetch_add( _n, std::memory_order_relaxed );
+    }
+
+  private:
+    std::atomic< long > &_count;
+    std::atomic< int64_t > &_time;
+    const long _n;
+    const int64_t _start;
+};
+
+Scheduler::Scheduler( HeartBeat &hb, Bank &bank,
         ConcurrentQueue< StateChange > &stateUpdateIn,
         ConcurrentQueue< StateChange > &stateUpdateOut,
         ConcurrentQueue< Command > &commandsToRemote,
-        ConcurrentQueue< Command > &commandsToLocal ) :
-    _localElevId( localId ),
+        std::unique_ptr< DispatchEngine > dispatch ) :
     _heartbeat( hb ),
-    _bounds( info ),
+    _bank( bank ),
+    _bounds( bank.info() ),
     _stateUpdateIn( stateUpdateIn ),
     _stateUpdateOut( stateUpdateOut ),
     _commandsToRemote( commandsToRemote ),
-    _commandsToLocal( commandsToLocal ),
-    _terminate( false )
+    _dispatch( dispatch ? std::move( dispatch )
+            : std::unique_ptr< DispatchEngine >( new EtaDispatch( _bounds ) ) ),
+    _terminate( false ),
+    _lastReassignment( 0 ),
+    _frozenUp( _bounds.maxFloor() - _bounds.minFloor() + 1, 0 ),
+    _frozenDown( _bounds.maxFloor() - _bounds.minFloor() + 1, 0 ),
+    _batchOpened( 0 ),
+    _traffic( _bounds ),
+    _lastParking( 0 ),
+    _decisions( 0 ), _rounds( 0 ), _updates( 0 ), _decisionTime( 0 ), _roundTime( 0 ),
+    _handled( INT64_MIN )
 { }
 
+Scheduler::Stats Scheduler::stats() const {
+    return Stats{ _decisions.load( std::memory_order_relaxed ),
+                  _decisionTime.load( std::memory_order_relaxed ),
+                  _rounds.load( std::memory_order_relaxed ),
+                  _roundTime.load( std::memory_order_relaxed ),
+                  _updates.load( std::memory_order_acquire ) };
+}
+
 Scheduler::~Scheduler() {
     if ( _thr.joinable() ) {
         _terminate = true;
@@ -32,9 +70,8 @@ void Scheduler::run() {
 const char *showChange( ChangeType );
 
 void Scheduler::_forwardToTargets( Command comm ) {
-    if ( comm.targetElevatorId == Command::ANY_ID || comm.targetElevatorId == _localElevId )
-        _commandsToLocal.enqueue( comm );
-    if ( comm.targetElevatorId != _localElevId )
+    _toBank.push_back( comm ); // bank ignores commands for other cars
+    if ( !_bank.has( comm.targetElevatorId ) )
         _commandsToRemote.enqueue( comm );
 }
 
@@ -45,40 +82,20 @@ void Scheduler::_handleButtonPress( int updateElId, ButtonType type, int floor )
                     Command::ANY_ID, floor };
     _forwardToTargets( lights );
 
-    // each elevator schedules changes originating from it
-    if ( updateElId == _localElevId ) {
+    // each bank schedules changes originating from its cars
+    if ( _bank.has( updateElId ) ) {
+        CpuTimer timer( _decisions, _decisionTime );
         // now find optimal elevator
+        auto global = _globalState.snapshot();
+        _dispatch->costs( global->fleet, Button( type, floor ), _costs );
+
         int minDistance = INT_MAX;
         int minId = INT_MIN;
-
-        for ( auto &statepair : _globalState.elevators() ) {
-            const ElevatorState &state = statepair.second;
-
-            int dist = std::abs( state.lastFloor - floor );
-
-            // penalizations for non-idle elevators
-            if ( state.stopped )
-                dist += 10 * (_bounds.maxFloor() - _bounds.minFloor()); // stopped penalization
-
-            if (    ( state.direction == Direction::Up
-                            && ( (type == ButtonType::CallUp && floor > state.lastFloor )
-                                || floor == _bounds.maxFloor() ) )
-                ||
-                    ( state.direction == Direction::Down
-                            && ( (type == ButtonType::CallDown && floor < state.lastFloor )
-                                || floor == _bounds.minFloor() ) )
-               )
-                dist += _bounds.maxFloor() - _bounds.minFloor() + 1; // busy penalization
-            else if ( state.direction != Direction::None ) // not idle
-                // as a last resort we can schedule floor even to elevator which is
-                // running in different direction
-                dist += 2 * (_bounds.maxFloor() - _bounds.minFloor() + 1); // penalization
-
-            if ( dist < minDistance ) {
-                minDistance = dist;
-                minId = state.id;
+        for ( int i = 0; i < int( _costs.size() ); ++i )
+            if ( _costs[ i ] < minDistance ) {
+                minDistance = _costs[ i ];
+                minId = i;
             }
-        }
         assert_leq( 0, minId, "no minimal distance found" );
 
         Command comm{ type == ButtonType::CallUp
@@ -89,48 +106,192 @@ void Scheduler::_handleButtonPress( int updateElId, ButtonType type, int floor )
     }
 }
 
+void Scheduler::_reassign() {
+    CpuTimer timer( _rounds, _roundTime );
+    const MillisecondTime t = _lastReassignment = now();
+    auto frozen = [&]( Button call ) -> MillisecondTime & {
+        return ( call.type() == ButtonType::CallUp ? _frozenUp : _frozenDown )
+            [ call.floor() - _bounds.minFloor() ];
+    };
+
+    auto global = _globalState.snapshot();
+    // each bank moves only calls of its own cars, so no call is moved by
+    // two schedulers at once; pick up of destination dispatch passengers
+    // stays with car which knows their destinations
+    auto moves = reassignCalls( *_dispatch, global->fleet, _bounds,
+            [&]( int id, Button call ) {
+                return _bank.has( id ) && frozen( call ) <= t
+                    && !global->fleet.destinations[ id ].hasAny();
+            }, _dispatch->hysteresis(), _maxMoves );
+
+    for ( const auto &move : moves ) {
+        const bool up = move.call.type() == ButtonType::CallUp;
+        const int floor = move.call.floor();
+        _forwardToTargets( Command{ up ? CommandType::CallToFloorAndGoUp
+                                       : CommandType::CallToFloorAndGoDown,
+                                    move.to, floor } );
+        _toBank.push_back( Command{ up ? CommandType::CancelCallUp : CommandType::CancelCallDown,
+                                move.from, floor } );
+        frozen( move.call ) = t + _reassignFreeze;
+        std::cerr << "reassigned call { floor = " << floor << ", up = " << up
+            << " } from " << move.from << " to " << move.to
+            << " (gain " << move.gain << ")" << std::endl;
+    }
+}
+
+void Scheduler::registerDestination( DestinationCall call ) {
+    assert_leq( _bounds.minFloor(), call.origin, "origin out of bounds" );
+    assert_leq( call.origin, _bounds.maxFloor(), "origin out of bounds" );
+    assert_leq( _bounds.minFloor(), call.destination, "destination out of bounds" );
+    assert_leq( call.destination, _bounds.maxFloor(), "destination out of bounds" );
+    assert_neq( call.origin, call.destination, "destination must differ from origin" );
+    _destinationCalls.enqueue( call );
+}
+
+void Scheduler::_assignDestinations() {
+    CpuTimer timer( _decisions, _decisionTime, _destinationBatch.size() );
+    auto global = _globalState.snapshot();
+    auto cars = assignDestinations( *_dispatch, global->fleet, _bounds, _destinationBatch );
+
+    std::vector< DestinationCall > unassigned;
+    for ( int i = 0; i < int( cars.size() ); ++i ) {
+        const DestinationCall &call = _destinationBatch[ i ];
+        if ( cars[ i ] == INT_MIN ) { // no car known yet, try with next batch
+            unassigned.push_back( call );
+            continue;
+        }
+        _forwardToTargets( Command{ CommandType::DestinationCall, cars[ i ],
+                                    call.origin, call.destination } );
+        std::cerr << "destination call { origin = " << call.origin
+            << ", destination = " << call.destination << " } assigned to "
+            << cars[ i ] << std::endl;
+    }
+    _destinationBatch.swap( unassigned );
+    _batchOpened = now();
+}
+
+void Scheduler::_park() {
+    CpuTimer timer( _rounds, _roundTime );
+    _lastParking = now();
+    auto global = _globalState.snapshot();
+    const FleetTable &fleet = global->fleet;
+    auto idle = [&]( int id ) {
+        return fleet.has( id ) && fleet.direction[ id ] == Direction::None
+            && !fleet.stopped[ id ] && !fleet.doorOpen[ id ]
+            && !( fleet.insideButtons[ id ] | fleet.upButtons[ id ]
+                  | fleet.downButtons[ id ] | fleet.destinations[ id ] ).hasAny();
+    };
+
+    std::vector< int > free; // idle local cars
+    for ( int id = _bank.firstId(); id < _bank.firstId() + _bank.size(); ++id )
+        if ( idle( id ) )
+            free.push_back( id );
+    if ( free.empty() )
+        return;
+
+    // one hot floor per car, floors with idle car (of any bank) are covered
+    auto hot = _traffic.hotFloors( timeOfDay(), fleet.count() );
+    std::vector< int > uncovered;
+    for ( int floor : hot ) {
+        int covering = INT_MIN;
+        for ( int id = 0; id < fleet.size() && covering == INT_MIN; ++id )
+            if ( idle( id ) && fleet.lastFloor[ id ] == floor )
+                covering = id;
+        if ( covering == INT_MIN )
+            uncovered.push_back( floor );
+        else
+            free.erase( std::remove( free.begin(), free.end(), covering ), free.end() );
+    }
+
+    // hottest floors first, each gets nearest free car
+    for ( int floor : uncovered ) {
+        if ( free.empty() )
+            break;
+        auto car = std::min_element( free.begin(), free.end(), [&]( int a, int b ) {
+                return std::abs( fleet.lastFloor[ a ] - floor )
+                     < std::abs( fleet.lastFloor[ b ] - floor );
+            } );
+        _toBank.push_back( Command{ CommandType::ParkAt, *car, floor } );
+        std::cerr << "parking " << *car << " at " << floor << std::endl;
+        free.erase( car );
+    }
+}
+
 void Scheduler::_runLocal() {
+    std::vector< StateChange > updates;
+    updates.reserve( _batchSize );
     while ( !_terminate.load( std::memory_order::memory_order_relaxed ) ) {
-        auto maybeUpdate = _stateUpdateIn.timeoutDequeue( _heartbeat.threshold() / 10 );
-        if ( !maybeUpdate.isNothing() ) {
-            auto update = maybeUpdate.value();
-            _globalState.update( update.state );
-            std::cerr << "state update: { id = " << update.state.id
-                << ", timestamp = " << update.state.timestamp
-                << ", changeType = " << showChange( update.changeType )
-                << ", changeFloor = " << update.changeFloor
-                << ", stopped = " << update.state.stopped
-                << ", direction = " << int( update.state.direction )
-                << " }" << std::endl;
-
-            if ( update.state.id == _localElevId ) {
-                _stateUpdateOut.enqueue( update ); // propagate update
-            }
+        // process all updates which arrived in meantime at once
+        updates.clear();
+        _stateUpdateIn.timeoutDequeueBatch( std::back_inserter( updates ),
+                _batchSize, _heartbeat.threshold() / 10 );
+        const MillisecondTime iteration = now(); // after updates were taken
+        for ( auto &update : updates )
+            _handleUpdate( update );
+        if ( _lastReassignment + _reassignPeriod <= now() )
+            _reassign();
 
-            // each elevator is responsible for scheduling commnads from its hardware
-            switch ( update.changeType ) {
-                case ChangeType::None:
-                case ChangeType::KeepAlive:
-                case ChangeType::OtherChange:
-                    continue;
-                case ChangeType::ButtonUpPressed:
-                    _handleButtonPress( update.state.id, ButtonType::CallUp, update.changeFloor );
-                    break;
-                case ChangeType::ButtonDownPressed:
-                    _handleButtonPress( update.state.id, ButtonType::CallDown, update.changeFloor );
-                    break;
-                case ChangeType::ServedDown:
-                    _forwardToTargets( Command{ CommandType::TurnOffLightDown,
-                            _localElevId, update.changeFloor } );
-                    break;
-                case ChangeType::ServedUp:
-                    _forwardToTargets( Command{ CommandType::TurnOffLightUp,
-                            _localElevId, update.changeFloor } );
-                    break;
-            }
+        DestinationCall call;
+        while ( _destinationCalls.tryDequeue( call ) ) {
+            if ( _destinationBatch.empty() )
+                _batchOpened = now();
+            _destinationBatch.push_back( call );
         }
+        if ( !_destinationBatch.empty() && _batchOpened + _destinationWindow <= now() )
+            _assignDestinations();
+        if ( _lastParking + _parkingPeriod <= now() )
+            _park();
+
+        _bank.deliver( _toBank );
+        _toBank.clear();
 
         _heartbeat.beat();
+        _updates.fetch_add( updates.size(), std::memory_order_relaxed );
+        _handled.store( iteration, std::memory_order_release );
+    }
+}
+
+void Scheduler::_handleUpdate( StateChange &update ) {
+    _globalState.update( update.state );
+    std::cerr << "state update: { id = " << update.state.id
+        << ", timestamp = " << update.state.timestamp
+        << ", changeType = " << showChange( update.changeType )
+        << ", changeFloor = " << update.changeFloor
+        << ", stopped = " << update.state.stopped
+        << ", direction = " << int( update.state.direction )
+        << " }" << std::endl;
+
+    const int id = update.state.id;
+    const ChangeType changeType = update.changeType;
+    const int changeFloor = update.changeFloor;
+
+    if ( _bank.has( id ) ) {
+        _stateUpdateOut.enqueue( std::move( update ) ); // propagate update
+    }
+
+    // each bank is responsible for scheduling commnads from its hardware
+    switch ( changeType ) {
+        case ChangeType::None:
+        case ChangeType::KeepAlive:
+        case ChangeType::OtherChange:
+            break;
+        case ChangeType::ButtonUpPressed:
+            _traffic.record( changeFloor, timeOfDay() );
+            _handleButtonPress( id, ButtonType::CallUp, changeFloor );
+            break;
+        case ChangeType::ButtonDownPressed:
+            _traffic.record( changeFloor, timeOfDay() );
+            _handleButtonPress( id, ButtonType::CallDown, changeFloor );
+            break;
+        // lamps of all local cars (remote banks handle the update themselves)
+        case ChangeType::ServedDown:
+            _toBank.push_back( Command{ CommandType::TurnOffLightDown,
+                    Command::ANY_ID, changeFloor } );
+            break;
+        case ChangeType::ServedUp:
+            _toBank.push_back( Command{ CommandType::TurnOffLightUp,
+                    Command::ANY_ID, changeFloor } );
+            break;
     }
 }
 
@@ -2,40 +2,104 @@
 #include <elevator/state.h>
 #include <elevator/command.h>
 #include <elevator/heartbeat.h>
+#include <elevator/bank.h>
+#include <elevator/dispatch.h>
+#include <elevator/traffic.h>
+#include <elevator/time.h>
 #include <thread>
 #include <atomic>
+#include <vector>
 
 #ifndef ELEVATOR_SCHEDULER_H
 #define ELEVATOR_SCHEDULER_H
 
 namespace elevator {
 
+/* schedules requests for all cars of local bank, state changes of local
+ * cars are propagated to stateUpdateOut, commands for cars which are not
+ * local go to commandsToRemote; commands for local cars are delivered
+ * to bank together at the end of each iteration of scheduling loop; car for hall call is selected by dispatch
+ * engine (EtaDispatch by default), calls assigned to local cars are
+ * periodically reassigned if other car can serve them notably cheaper;
+ * in destination dispatch mode passengers registered at landings are
+ * assigned to cars in batches (see registerDestination); idle cars are
+ * parked at floors where calls are expected (see TrafficModel) */
 struct Scheduler {
-    Scheduler( int, HeartBeat &, BasicDriverInfo info,
-            ConcurrentQueue< StateChange > &,
-            ConcurrentQueue< StateChange > &,
-            ConcurrentQueue< Command > &,
-            ConcurrentQueue< Command > & );
+    Scheduler( HeartBeat &, Bank &,
+            ConcurrentQueue< StateChange > &stateUpdateIn,
+            ConcurrentQueue< StateChange > &stateUpdateOut,
+            ConcurrentQueue< Command > &commandsToRemote,
+            std::unique_ptr< DispatchEngine > = nullptr );
     ~Scheduler();
 
     void run();
 
+    /** register passenger at landing panel (destination dispatch), thread
+     * safe, passenger is assigned to car with next batch */
+    void registerDestination( DestinationCall );
+
+    /* cost of scheduling decisions (CPU time of scheduler thread) */
+    struct Stats {
+        long decisions;       // hall calls and destination calls assigned
+        int64_t decisionTime; // ns
+        long rounds;          // periodic reassignment and parking rounds
+        int64_t roundTime;    // ns
+        long updates;         // state changes handled (by finished iterations)
+    };
+    Stats stats() const;
+
+    /** time at which scheduling loop finished its last iteration: state
+     * changes taken from queue by then and periodic work due at that time
+     * are handled (similar to Elevator::lastCycle) */
+    MillisecondTime handledUntil() const {
+        return _handled.load( std::memory_order_acquire );
+    }
+
   private:
-    int _localElevId;
     HeartBeat &_heartbeat;
+    Bank &_bank;
     BasicDriverInfo _bounds;
     ConcurrentQueue< StateChange > &_stateUpdateIn;
     ConcurrentQueue< StateChange > &_stateUpdateOut;
     ConcurrentQueue< Command > &_commandsToRemote;
-    ConcurrentQueue< Command > &_commandsToLocal;
+    std::unique_ptr< DispatchEngine > _dispatch;
     GlobalState _globalState;
     std::thread _thr;
     std::atomic< bool > _terminate;
+    std::vector< int > _costs; // per elevator, reused by _handleButtonPress
+    // commands for local cars, delivered together at the end of iteration
+    std::vector< Command > _toBank;
+    MillisecondTime _lastReassignment;
+    // per floor (from minFloor), time until which call must not be moved again
+    std::vector< MillisecondTime > _frozenUp, _frozenDown;
+    ConcurrentQueue< DestinationCall > _destinationCalls;
+    std::vector< DestinationCall > _destinationBatch; // scheduler thread only
+    MillisecondTime _batchOpened;
+    TrafficModel _traffic;
+    MillisecondTime _lastParking;
+    std::atomic< long > _decisions, _rounds, _updates;
+    std::atomic< int64_t > _decisionTime, _roundTime;
+    std::atomic< MillisecondTime > _handled;
 
     void _runLocal();
+    void _handleUpdate( StateChange & );
 
     void _handleButtonPress( int, ButtonType, int );
     void _forwardToTargets( Command );
+    void _reassign();
+    void _assignDestinations();
+    void _park();
+
+    // maximal number of state updates taken from queue at once
+    static const size_t _batchSize = 64;
+    static constexpr MillisecondTime _reassignPeriod = 1000;
+    // moved call is not moved again until new state of both cars arrives
+    static constexpr MillisecondTime _reassignFreeze = 3000;
+    static const int _maxMoves = 4; // per reassignment round
+    // registrations are collected for this long so that passengers with
+    // same destination can be grouped
+    static constexpr MillisecondTime _destinationWindow = 500;
+    static constexpr MillisecondTime _parkingPeriod = 5000;
 };
 
 }
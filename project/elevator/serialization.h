@@ -28,7 +28,9 @@ enum class TypeSignature {
     InitialPacket,
     ElevatorReady,
     RecoveryState,
-    RecoveryPeers
+    RecoveryPeers,
+
+    DestinationCall
 };
 
 template< typename T >
@@ -1,6 +1,10 @@
 // C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
 
 #include <mutex>
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <vector>
 #include <type_traits>
 
 #ifndef SRC_SHARED_BLOCK_H
@@ -53,6 +57,235 @@ struct SharedBlock {
     T _data;
 };
 
+/* same interface as SharedBlock, but for read-mostly data: readers never
+ * lock (nor write to shared memory), they copy data optimistically and retry
+ * if writer was active meanwhile (seqlock), writers are serialized by mutex
+ * and bump sequence number before and after modification (odd sequence
+ * number means write is in progress)
+ *
+ * T must be trivially copyable as it can be copied while being modified
+ * (such copy is always discarded)
+ */
+template< typename T >
+struct SeqLockBlock {
+    static_assert( std::is_trivially_copyable< T >::value,
+            "SeqLockBlock requires trivially copyable type" );
+
+    SeqLockBlock() : _seq( 0 ), _data() { }
+    explicit SeqLockBlock( T data ) : _seq( 0 ), _data( std::move( data ) ) { }
+
+    template< typename... Ts >
+    SeqLockBlock( Ts &&...args ) : _seq( 0 ), _data( std::forward< Ts >( args )... ) { }
+
+    /** returns snapshot of consistent data, lock-free
+     */
+    T snapshot() const {
+        T copy;
+        for ( ;; ) {
+            unsigned seq = _seq.load( std::memory_order_acquire );
+            if ( seq & 1 )
+                continue; // write in progress
+            std::memcpy( &copy, &_data, sizeof( T ) );
+            std::atomic_thread_fence( std::memory_order_acquire );
+            if ( _seq.load( std::memory_order_relaxed ) == seq )
+                return copy;
+        }
+    }
+
+    /** sequence number, changes with each write, can be used to find out
+     * data were modified without copying them */
+    unsigned version() const {
+        return _seq.load( std::memory_order_acquire ) & ~1u;
+    }
+
+    template< typename Function >
+    auto atomically( Function function ) -> typename
+        std::enable_if<
+            !std::is_void< typename std::result_of< Function( T & ) >::type >::value,
+            typename std::result_of< Function( T & ) >::type >::type
+    { // non-void version
+        Guard g{ _lock };
+        _beginWrite();
+        auto ret = function( _data );
+        _endWrite();
+        return ret;
+    }
+
+    template< typename Function >
+    auto atomically( Function function ) -> typename
+        std::enable_if< std::is_void< typename std::result_of< Function( T & ) >::type >::value >::type
+    { // void version
+        Guard g{ _lock };
+        _beginWrite();
+        function( _data );
+        _endWrite();
+    }
+
+  private:
+    using Guard = std::unique_lock< std::mutex >;
+    std::mutex _lock;
+    std::atomic< unsigned > _seq;
+    T _data;
+
+    void _beginWrite() {
+        _seq.store( _seq.load( std::memory_order_relaxed ) + 1, std::memory_order_relaxed );
+        std::atomic_thread_fence( std::memory_order_release );
+    }
+
+    void _endWrite() {
+        _seq.store( _seq.load( std::memory_order_relaxed ) + 1, std::memory_order_release );
+    }
+};
+
+
+/* read-copy-update block for larger read-mostly data which are not
+ * trivially copyable: current version is immutable and published by atomic
+ * pointer, readers obtain Snapshot which references it (no copy, no lock),
+ * writers copy current version, modify the copy and publish it
+ *
+ * Reclamation is deferred: readers register in one of two phase counters
+ * while they hold snapshot, old versions retired in phase p are reclaimed
+ * once phase was flipped and no reader from it remains. Writers never wait
+ * for readers, if some reader keeps snapshot for long time old versions
+ * just pile up until it releases it. Few reclaimed versions are kept and
+ * reused as targets of copy assignment for next writes, so writing does
+ * not allocate if T keeps its storage on assignment (e.g. vectors which do
+ * not grow); T must be copy assignable.
+ */
+template< typename T >
+struct RcuBlock {
+
+    /** handle to immutable version of data, data stay valid as long as
+     * handle exists (it should not be held for long) */
+    struct Snapshot {
+        Snapshot( Snapshot &&o ) : _data( o._data ), _readers( o._readers ) {
+            o._readers = nullptr;
+        }
+        Snapshot( const Snapshot & ) = delete;
+        ~Snapshot() {
+            if ( _readers )
+                _readers->fetch_sub( 1, std::memory_order_release );
+        }
+
+        const T &operator*() const { return *_data; }
+        const T *operator->() const { return _data; }
+        const T *get() const { return _data; }
+
+      private:
+        friend struct RcuBlock;
+        Snapshot( const T *data, std::atomic< long > *readers ) :
+            _data( data ), _readers( readers )
+        { }
+
+        const T *_data;
+        std::atomic< long > *_readers;
+    };
+
+    RcuBlock() : RcuBlock( T() ) { }
+    explicit RcuBlock( T data ) :
+        _current( new T( std::move( data ) ) ), _phase( 0 ), _version( 0 )
+    {
+        _readers[ 0 ].store( 0, std::memory_order_relaxed );
+        _readers[ 1 ].store( 0, std::memory_order_relaxed );
+    }
+
+    RcuBlock( const RcuBlock & ) = delete;
+
+    ~RcuBlock() {
+        // no snapshot can outlive block
+        delete _current.load( std::memory_order_acquire );
+    }
+
+    /** lock-free, returns handle to current version of data
+     */
+    Snapshot snapshot() const {
+        for ( ;; ) {
+            unsigned phase = _phase.load( std::memory_order_seq_cst );
+            std::atomic< long > &readers = _readers[ phase & 1 ];
+            readers.fetch_add( 1, std::memory_order_seq_cst );
+            // writer could have flipped phase in meantime and it might not
+            // wait for us (it could have seen zero readers in our counter)
+            if ( _phase.load( std::memory_order_seq_cst ) == phase )
+                return Snapshot( _current.load( std::memory_order_seq_cst ), &readers );
+            readers.fetch_sub( 1, std::memory_order_release );
+        }
+    }
+
+    /** changes with each published version */
+    unsigned version() const {
+        return _version.load( std::memory_order_acquire );
+    }
+
+    /* same as atomically of SharedBlock, but function operates on copy of
+     * current version which gets published after function returns */
+    template< typename Function >
+    auto atomically( Function function ) -> typename
+        std::enable_if<
+            !std::is_void< typename std::result_of< Function( T & ) >::type >::value,
+            typename std::result_of< Function( T & ) >::type >::type
+    { // non-void version
+        Guard g{ _lock };
+        std::unique_ptr< T > copy = _copyCurrent();
+        auto ret = function( *copy );
+        _publish( std::move( copy ) );
+        return ret;
+    }
+
+    template< typename Function >
+    auto atomically( Function function ) -> typename
+        std::enable_if< std::is_void< typename std::result_of< Function( T & ) >::type >::value >::type
+    { // void version
+        Guard g{ _lock };
+        std::unique_ptr< T > copy = _copyCurrent();
+        function( *copy );
+        _publish( std::move( copy ) );
+    }
+
+  private:
+    using Guard = std::unique_lock< std::mutex >;
+    std::mutex _lock;
+    std::atomic< T * > _current;
+    std::atomic< unsigned > _phase;
+    mutable std::atomic< long > _readers[ 2 ];
+    std::atomic< unsigned > _version;
+    // owned by writers (under lock)
+    std::vector< std::unique_ptr< T > > _retiredNow;
+    std::vector< std::unique_ptr< T > > _retiredBefore;
+    std::vector< std::unique_ptr< T > > _spare; // reclaimed, for reuse
+
+    static const size_t _maxSpare = 4;
+
+    std::unique_ptr< T > _copyCurrent() {
+        const T &current = *_current.load( std::memory_order_relaxed );
+        if ( _spare.empty() )
+            return std::unique_ptr< T >( new T( current ) );
+        std::unique_ptr< T > copy = std::move( _spare.back() );
+        _spare.pop_back();
+        *copy = current;
+        return copy;
+    }
+
+    void _publish( std::unique_ptr< T > data ) {
+        T *old = _current.exchange( data.release(), std::memory_order_seq_cst );
+        _version.fetch_add( 1, std::memory_order_release );
+        _retiredNow.emplace_back( old );
+
+        // versions retired before last flip can be seen only by readers
+        // registered in previous phase (those registered later had to see
+        // newer pointer), once they are gone we can reclaim them and flip
+        // again (counter of previous phase becomes current one)
+        unsigned phase = _phase.load( std::memory_order_relaxed );
+        if ( _readers[ (phase + 1) & 1 ].load( std::memory_order_acquire ) == 0 ) {
+            for ( auto &old : _retiredBefore )
+                if ( _spare.size() < _maxSpare )
+                    _spare.push_back( std::move( old ) );
+            _retiredBefore.clear();
+            _retiredBefore.swap( _retiredNow );
+            _phase.store( phase + 1, std::memory_order_seq_cst );
+        }
+    }
+};
+
 }
 
 #endif // SRC_SHARED_BLOCK_H
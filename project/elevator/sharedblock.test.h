@@ -2,6 +2,7 @@
 
 #include <elevator/sharedblock.h>
 #include <elevator/test.h>
+#include <thread>
 
 using namespace elevator;
 
@@ -20,4 +21,58 @@ struct TestSharedBlock {
             } ), 42, "atomically" );
         assert_eq( block.snapshot(), 42, "new state" );
     }
+
+    Test seqLockSimple() {
+        SeqLockBlock< int > block{ 42 };
+        assert_eq( block.snapshot(), 42, "snapshot" );
+        unsigned v = block.version();
+        block.atomically( []( int &data ) { data = 1; } );
+        assert_eq( block.snapshot(), 1, "new state" );
+        assert_neq( block.version(), v, "version should change" );
+        assert_eq( block.atomically( []( int &data ) { return ++data; } ), 2, "atomically" );
+    }
+
+    struct Pair { long a, b; };
+
+    Test seqLockConsistent() {
+        SeqLockBlock< Pair > block{ Pair{ 0, 0 } };
+        std::atomic< bool > done{ false };
+        std::thread writer( [&]() {
+                for ( long i = 1; i <= 100000; ++i )
+                    block.atomically( [i]( Pair &p ) { p.a = i; p.b = -i; } );
+                done = true;
+            } );
+        long last = 0;
+        while ( !done ) {
+            Pair p = block.snapshot();
+            assert_eq( p.a, -p.b, "torn read" );
+            assert_leq( last, p.a, "time goes backwards" );
+            last = p.a;
+        }
+        writer.join();
+        assert_eq( block.snapshot().a, 100000, "final state" );
+    }
+
+    Test rcuSimple() {
+        RcuBlock< std::vector< int > > block{ std::vector< int >{ 1, 2 } };
+        auto old = block.snapshot();
+        unsigned v = block.version();
+        block.atomically( []( std::vector< int > &data ) { data.push_back( 3 ); } );
+        assert_eq( old->size(), 2ul, "snapshot must not change" );
+        assert_eq( block.snapshot()->size(), 3ul, "new state" );
+        assert_neq( block.version(), v, "version should change" );
+        assert_eq( block.atomically( []( std::vector< int > &data ) { return data.size(); } ),
+                3ul, "atomically" );
+    }
+
+    Test rcuReuse() {
+        RcuBlock< std::vector< int > > block{ std::vector< int >{ 0 } };
+        auto held = block.snapshot();
+        for ( int i = 1; i <= 100; ++i )
+            block.atomically( [i]( std::vector< int > &data ) { data[ 0 ] = i; } );
+        // reused versions must not include one which is still being read
+        assert_eq( ( *held )[ 0 ], 0, "held snapshot must not change" );
+        assert_eq( ( *block.snapshot() )[ 0 ], 100, "new state" );
+        assert_eq( block.snapshot()->size(), 1ul, "new state" );
+    }
 };
@@ -0,0 +1,180 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/simulator.h>
+#include <elevator/test.h>
+#include <elevator/time.h>
+
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+
+namespace lowlevel {
+
+// time of elevator clock in seconds, so that simulation follows it
+static double realTime() {
+    return elevator::now() / 1000.0;
+}
+
+Simulator::Simulator( Config config ) { reset( config ); }
+
+Simulator &Simulator::device( const std::string &name ) {
+    static std::mutex lock;
+    static std::map< std::string, std::unique_ptr< Simulator > > devices;
+
+    std::unique_lock< std::mutex > g{ lock };
+    auto &sim = devices[ name ];
+    if ( !sim )
+        sim.reset( new Simulator() );
+    return *sim;
+}
+
+void Simulator::reset( Config config ) {
+    assert_lt( 0, config.floorTime, "invalid floor time" );
+    config.layout.assertConsistency();
+    Guard g{ _lock };
+    _config = std::move( config );
+    _realStart = realTime();
+    _time = 0;
+    _position = _config.startPosition;
+    _motor = 0;
+    _bits = IO::Ports();
+    _events.clear();
+    _updateSensors();
+}
+
+double Simulator::_velocity() const {
+    int speed = _motor > 2048 ? ( _motor - 2048 ) / 4 : 0;
+    double v = speed / ( 300.0 * _config.floorTime );
+    return _bits.bit( _config.layout.motorDirection ) ? -v : v;
+}
+
+void Simulator::_move( double until ) {
+    if ( until <= _time )
+        return;
+    _position += _velocity() * ( until - _time );
+    // car stops at end switches slightly behind last floors
+    _position = std::max( -0.5, std::min( _position, floors() - 0.5 ) );
+    _time = until;
+    _updateSensors();
+}
+
+void Simulator::_updateSensors() {
+    for ( int i = 0; i < floors(); ++i )
+        _setBit( _config.layout.sensors[ i ], std::abs( _position - i ) <= _config.sensorWidth / 2 );
+}
+
+void Simulator::_setBit( int channel, bool value ) {
+    if ( channel < 0 )
+        return;
+    uint32_t bit = 1u << ( channel & 0xff );
+    if ( value )
+        _bits.bits[ channel >> 8 ] |= bit;
+    else
+        _bits.bits[ channel >> 8 ] &= ~bit;
+}
+
+/* bring simulation to current time, scheduled events are run in order
+ * (without lock, so that they can use public interface) */
+void Simulator::_advance( Guard &g ) {
+    for ( ;; ) {
+        double target = ( realTime() - _realStart ) * _config.timeScale;
+        auto it = _events.begin();
+        if ( it == _events.end() || it->first > target ) {
+            _move( target );
+            return;
+        }
+        _move( it->first );
+        Event event = std::move( it->second );
+        _events.erase( it );
+        g.unlock();
+        event( *this );
+        g.lock();
+    }
+}
+
+void Simulator::writeBit( int channel, bool value ) {
+    Guard g{ _lock };
+    _advance( g );
+    _setBit( channel, value );
+}
+
+bool Simulator::readBit( int channel ) {
+    Guard g{ _lock };
+    _advance( g );
+    return _bits.bit( channel );
+}
+
+void Simulator::writeAnalog( int channel, int value ) {
+    Guard g{ _lock };
+    _advance( g );
+    if ( channel == _config.layout.motor )
+        _motor = value;
+}
+
+IO::Ports Simulator::readPorts() {
+    Guard g{ _lock };
+    _advance( g );
+    return _bits;
+}
+
+void Simulator::writePort( int subdevice, uint32_t mask, uint32_t bits ) {
+    Guard g{ _lock };
+    _advance( g );
+    _bits.bits[ subdevice ] = ( _bits.bits[ subdevice ] & ~mask ) | ( bits & mask );
+}
+
+void Simulator::pressButton( int channel ) {
+    Guard g{ _lock };
+    _advance( g );
+    _setBit( channel, true );
+    _events.emplace( _time + _config.pressTime,
+            [channel]( Simulator &sim ) {
+                Guard g{ sim._lock };
+                sim._setBit( channel, false );
+            } );
+}
+
+void Simulator::setObstruction( bool value ) {
+    Guard g{ _lock };
+    _advance( g );
+    _setBit( _config.layout.obstruction, value );
+}
+
+void Simulator::at( double time, Event event ) {
+    Guard g{ _lock };
+    _events.emplace( time, std::move( event ) );
+}
+
+double Simulator::time() {
+    Guard g{ _lock };
+    _advance( g );
+    return _time;
+}
+
+double Simulator::position() {
+    Guard g{ _lock };
+    _advance( g );
+    return _position;
+}
+
+double Simulator::velocity() {
+    Guard g{ _lock };
+    _advance( g );
+    return _velocity();
+}
+
+int Simulator::sensorFloor() {
+    Guard g{ _lock };
+    _advance( g );
+    for ( int i = 0; i < floors(); ++i )
+        if ( _bits.bit( _config.layout.sensors[ i ] ) )
+            return i;
+    return -1;
+}
+
+bool Simulator::output( int channel ) {
+    Guard g{ _lock };
+    return _bits.bit( channel );
+}
+
+}
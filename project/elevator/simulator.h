@@ -0,0 +1,110 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Simulated elevator hardware, used as backend of lowlevel::IO when
+ * libComedi is not available (and usable directly in tests)
+ *
+ * It models position and velocity of car according to motor and motor
+ * direction outputs of building layout (see elevator/layout.h), sets floor
+ * sensors when car is near floor, keeps state of all
+ * lamps and allows environment (tests, load generators) to press buttons,
+ * stop button and obstruction switch, either immediately or at given
+ * simulated time.
+ *
+ * Simulation is evaluated lazily on each access, simulated time runs
+ * timeScale times faster than time of elevator clock (see elevator/time.h),
+ * which is real time unless replaced.
+ */
+
+#include <elevator/io.h>
+#include <elevator/layout.h>
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <map>
+#include <memory>
+
+#ifndef SRC_SIMULATOR_H
+#define SRC_SIMULATOR_H
+
+namespace lowlevel {
+
+struct Simulator {
+
+    struct Config {
+        Config() : timeScale( 1 ), floorTime( 2.5 ), sensorWidth( 0.15 ),
+            pressTime( 0.2 ), startPosition( 0 ),
+            layout( elevator::Layout::current() )
+        { }
+
+        double timeScale;     // simulated seconds per clock second
+        double floorTime;     // seconds per floor at nominal speed (300)
+        double sensorWidth;   // in floors, sensor is active around floor
+        double pressTime;     // how long are buttons held
+        double startPosition; // in floors, 0 is lowest floor
+        elevator::Layout layout;
+    };
+
+    using Event = std::function< void( Simulator & ) >;
+
+    explicit Simulator( Config config = Config() );
+    Simulator( const Simulator & ) = delete;
+
+    /** simulator for given device name, created on first use, all IO
+     * instances opened with same name share it (as they would share
+     * hardware) */
+    static Simulator &device( const std::string &name );
+
+    /** restart simulation (time, position, all channels) with new config */
+    void reset( Config config = Config() );
+
+    // hardware side, used by lowlevel::IO
+    void writeBit( int channel, bool value );
+    bool readBit( int channel );
+    void writeAnalog( int channel, int value );
+    IO::Ports readPorts();
+    void writePort( int subdevice, uint32_t mask, uint32_t bits );
+
+    // environment side
+    /** press and release (after pressTime) button with given input channel */
+    void pressButton( int channel );
+    void pressStop() { pressButton( _config.layout.stop ); }
+    void setObstruction( bool value );
+    /** run event at given simulated time (in seconds) */
+    void at( double time, Event event );
+
+    int floors() const { return _config.layout.floors(); }
+    const elevator::Layout &layout() const { return _config.layout; }
+
+    /** simulated time in seconds */
+    double time();
+    /** position in floors, 0 is lowest floor */
+    double position();
+    /** in floors per second, positive is up */
+    double velocity();
+    /** floor (from 0) if car is at floor sensor, -1 otherwise */
+    int sensorFloor();
+    bool output( int channel );
+
+  private:
+    using Guard = std::unique_lock< std::mutex >;
+
+    std::mutex _lock;
+    Config _config;
+    double _realStart;   // real time (seconds) of simulated time 0
+    double _time;        // simulated time of last update
+    double _position;
+    int _motor;          // last analog value written to MOTOR
+    IO::Ports _bits;     // all digital channels (inputs and outputs)
+    std::multimap< double, Event > _events;
+
+    void _advance( Guard & );
+    void _move( double until );
+    void _setBit( int channel, bool value );
+    double _velocity() const;
+    void _updateSensors();
+};
+
+}
+
+#endif // SRC_SIMULATOR_H
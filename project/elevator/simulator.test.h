@@ -0,0 +1,80 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/simulator.h>
+#include <elevator/channels.h>
+#include <elevator/driver.h>
+#include <elevator/test.h>
+#include <thread>
+
+using namespace lowlevel;
+
+struct TestSimulator {
+
+    static Simulator::Config _fast() {
+        Simulator::Config config;
+        config.timeScale = 20;
+        config.floorTime = 1;
+        return config;
+    }
+
+    Test sensors() {
+        Simulator sim{ _fast() };
+        assert_eq( sim.sensorFloor(), 0, "starts at lowest floor" );
+        sim.writeBit( MOTORDIR, false ); // up
+        sim.writeAnalog( MOTOR, 2048 + 4 * 300 );
+        while ( sim.position() < 2 )
+            std::this_thread::yield();
+        sim.writeAnalog( MOTOR, 0 );
+        double pos = sim.position();
+        assert_leq( 2.0, pos, "moved" );
+        assert_eq( sim.velocity(), 0.0, "stopped" );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+        assert_eq( sim.position(), pos, "stays stopped" );
+    }
+
+    Test endStop() {
+        Simulator sim{ _fast() };
+        sim.writeBit( MOTORDIR, true ); // down
+        sim.writeAnalog( MOTOR, 2048 + 4 * 300 );
+        while ( sim.time() < 2 )
+            std::this_thread::yield();
+        assert_eq( sim.position(), -0.5, "end stop" );
+        assert_eq( sim.sensorFloor(), -1, "below lowest floor" );
+    }
+
+    Test buttons() {
+        Simulator sim{ _fast() };
+        sim.pressButton( FLOOR_UP2 );
+        assert( sim.readBit( FLOOR_UP2 ), "pressed" );
+        assert( sim.readPorts().bit( FLOOR_UP2 ), "pressed (ports)" );
+        while ( sim.time() < 1 )
+            std::this_thread::yield();
+        assert( !sim.readBit( FLOOR_UP2 ), "released" );
+    }
+
+    Test script() {
+        Simulator sim{ _fast() };
+        bool fired = false;
+        sim.at( 0.5, [&]( Simulator &s ) { s.setObstruction( true ); fired = true; } );
+        assert( !sim.readBit( OBSTRUCTION ), "not yet" );
+        while ( sim.time() < 1 )
+            std::this_thread::yield();
+        assert( fired, "event" );
+        assert( sim.readBit( OBSTRUCTION ), "obstruction" );
+    }
+
+    Test driver() {
+        Simulator &sim = Simulator::device( "/dev/comedi0" );
+        sim.reset( _fast() );
+        elevator::Driver driver;
+        driver.setButtonLamp( elevator::Button( elevator::ButtonType::CallUp, 2 ), true );
+        driver.flush();
+        assert( sim.output( LIGHT_UP2 ), "lamp" );
+        driver.setMotorSpeed( elevator::Direction::Up, 300 );
+        while ( driver.getFloor() != 3 )
+            std::this_thread::yield();
+        driver.stopElevator();
+        assert_eq( driver.sample().floor, 3, "sample" );
+        sim.reset();
+    }
+};
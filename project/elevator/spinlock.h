@@ -1,18 +1,107 @@
 // C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
 
 #include <atomic>
+#include <thread>
+#include <cstdint>
 
-/* simple spin-lock raii guard to be used with atomic_flag */
+#if defined( __x86_64__ ) || defined( __i386__ )
+#include <immintrin.h>
+#endif
+
+/* spin locks for very short critical sections
+ *
+ * SpinLock is simple raii guard to be used with atomic_flag, other locks
+ * (TTASLock, TicketLock, MCSLock) have nested Guard type so that they are
+ * used same way:
+ *
+ *     TicketLock lock;
+ *     { TicketLock::Guard g{ lock }; ... }
+ *
+ * all of them count acquisitions and contended acquisitions, see stats(),
+ * so that right lock can be chosen for given place by measurement
+ */
 
 #ifndef SRC_SPIN_LOCK_H
 #define SRC_SPIN_LOCK_H
 
 namespace elevator {
 
+/* hint for CPU that we are spinning (saves power and does not steal cycles
+ * from hyperthread sibling) */
+inline void cpuRelax() {
+#if defined( __x86_64__ ) || defined( __i386__ )
+    _mm_pause();
+#else
+    std::atomic_signal_fence( std::memory_order_seq_cst );
+#endif
+}
+
+/* exponential backoff: spin with pause for increasing time, once limit is
+ * reached yield so that lock holder can run on oversubscribed machine */
+struct Backoff {
+    Backoff() : _spins( 1 ) { }
+
+    void pause() {
+        if ( _spins <= _limit ) {
+            for ( unsigned i = 0; i < _spins; ++i )
+                cpuRelax();
+            _spins <<= 1;
+        } else
+            std::this_thread::yield();
+    }
+
+  private:
+    static const unsigned _limit = 1024;
+    unsigned _spins;
+};
+
+struct LockStats {
+    uint64_t acquired;
+    uint64_t contended; // acquisitions which had to wait
+};
+
+namespace _internal {
+
+struct LockCounters {
+    LockCounters() : _acquired( 0 ), _contended( 0 ) { }
+
+    LockStats stats() const {
+        return LockStats{ _acquired.load( std::memory_order_relaxed ),
+                          _contended.load( std::memory_order_relaxed ) };
+    }
+
+  protected:
+    // modified only by lock holder, so relaxed load + store is enough
+    void _count( bool contended ) {
+        _acquired.store( _acquired.load( std::memory_order_relaxed ) + 1,
+                std::memory_order_relaxed );
+        if ( contended )
+            _contended.store( _contended.load( std::memory_order_relaxed ) + 1,
+                    std::memory_order_relaxed );
+    }
+
+  private:
+    std::atomic< uint64_t > _acquired;
+    std::atomic< uint64_t > _contended;
+};
+
+template< typename Lock >
+struct LockGuard {
+    explicit LockGuard( Lock &lock ) : _lock( lock ) { _lock.lock(); }
+    LockGuard( const LockGuard & ) = delete;
+    ~LockGuard() { _lock.unlock(); }
+
+  private:
+    Lock &_lock;
+};
+
+}
+
 struct SpinLock {
     SpinLock( std::atomic_flag &flag ) : flag( flag ) {
+        Backoff backoff;
         while ( flag.test_and_set( std::memory_order_acquire ) )
-        { }
+            backoff.pause();
     }
 
     ~SpinLock() {
@@ -23,6 +112,150 @@ struct SpinLock {
     std::atomic_flag &flag;
 };
 
+/* test-and-test-and-set lock with exponential backoff, waiters spin on read
+ * of (shared) cache line and only try to write it once lock seems free;
+ * cheapest when uncontended, unfair */
+struct TTASLock : _internal::LockCounters {
+    using Guard = _internal::LockGuard< TTASLock >;
+
+    TTASLock() : _locked( false ) { }
+    TTASLock( const TTASLock & ) = delete;
+
+    bool try_lock() {
+        if ( _locked.load( std::memory_order_relaxed )
+                || _locked.exchange( true, std::memory_order_acquire ) )
+            return false;
+        _count( false );
+        return true;
+    }
+
+    void lock() {
+        if ( !_locked.exchange( true, std::memory_order_acquire ) ) {
+            _count( false );
+            return;
+        }
+        Backoff backoff;
+        do {
+            while ( _locked.load( std::memory_order_relaxed ) )
+                backoff.pause();
+        } while ( _locked.exchange( true, std::memory_order_acquire ) );
+        _count( true );
+    }
+
+    void unlock() { _locked.store( false, std::memory_order_release ); }
+
+  private:
+    std::atomic< bool > _locked;
+};
+
+/* ticket lock, FIFO fair; waiters back off proportionally to their distance
+ * from head of queue */
+struct TicketLock : _internal::LockCounters {
+    using Guard = _internal::LockGuard< TicketLock >;
+
+    TicketLock() : _next( 0 ), _serving( 0 ) { }
+    TicketLock( const TicketLock & ) = delete;
+
+    bool try_lock() {
+        uint32_t serving = _serving.load( std::memory_order_relaxed );
+        uint32_t expected = serving;
+        if ( !_next.compare_exchange_strong( expected, serving + 1,
+                    std::memory_order_acquire, std::memory_order_relaxed ) )
+            return false;
+        _count( false );
+        return true;
+    }
+
+    void lock() {
+        uint32_t ticket = _next.fetch_add( 1, std::memory_order_relaxed );
+        uint32_t serving = _serving.load( std::memory_order_acquire );
+        if ( serving == ticket ) {
+            _count( false );
+            return;
+        }
+        for ( unsigned rounds = 0; serving != ticket; ++rounds ) {
+            uint32_t ahead = ticket - serving;
+            if ( ahead > _maxSpinDistance || rounds >= _maxSpinRounds ) {
+                // too many before us (or some of them is probably preempted),
+                // do not burn CPU which they need
+                std::this_thread::yield();
+            } else
+                for ( uint32_t i = 0; i < ahead * _spinsPerWaiter; ++i )
+                    cpuRelax();
+            serving = _serving.load( std::memory_order_acquire );
+        }
+        _count( true );
+    }
+
+    void unlock() {
+        _serving.store( _serving.load( std::memory_order_relaxed ) + 1,
+                std::memory_order_release );
+    }
+
+  private:
+    static const uint32_t _maxSpinDistance = 8;
+    static const uint32_t _spinsPerWaiter = 64;
+    static const unsigned _maxSpinRounds = 16;
+    std::atomic< uint32_t > _next;
+    std::atomic< uint32_t > _serving;
+};
+
+/* MCS queue lock: each waiter spins on flag in its own node (which lives in
+ * guard), so there is no cache line bouncing under contention and lock is
+ * FIFO fair; usable only through Guard */
+struct MCSLock : _internal::LockCounters {
+  private:
+    struct Node {
+        Node() : next( nullptr ), locked( true ) { }
+        std::atomic< Node * > next;
+        std::atomic< bool > locked;
+    };
+
+  public:
+    struct Guard {
+        explicit Guard( MCSLock &lock ) : _lock( lock ) { _lock._lock( _node ); }
+        Guard( const Guard & ) = delete;
+        ~Guard() { _lock._unlock( _node ); }
+
+      private:
+        MCSLock &_lock;
+        Node _node;
+    };
+
+    MCSLock() : _tail( nullptr ) { }
+    MCSLock( const MCSLock & ) = delete;
+
+  private:
+    std::atomic< Node * > _tail;
+
+    void _lock( Node &node ) {
+        Node *prev = _tail.exchange( &node, std::memory_order_acq_rel );
+        if ( !prev ) {
+            _count( false );
+            return;
+        }
+        prev->next.store( &node, std::memory_order_release );
+        Backoff backoff;
+        while ( node.locked.load( std::memory_order_acquire ) )
+            backoff.pause();
+        _count( true );
+    }
+
+    void _unlock( Node &node ) {
+        Node *next = node.next.load( std::memory_order_acquire );
+        if ( !next ) {
+            Node *expected = &node;
+            if ( _tail.compare_exchange_strong( expected, nullptr,
+                        std::memory_order_release, std::memory_order_relaxed ) )
+                return;
+            // successor is just linking itself
+            while ( !( next = node.next.load( std::memory_order_acquire ) ) )
+                cpuRelax();
+        }
+        next->locked.store( false, std::memory_order_release );
+    }
+};
+
 }
 
 #endif // SRC_SPIN_LOCK_H
@@ -0,0 +1,59 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/spinlock.h>
+#include <elevator/test.h>
+#include <thread>
+#include <vector>
+
+using namespace elevator;
+
+struct TestSpinLock {
+
+    template< typename Lock >
+    void _exclusion() {
+        Lock lock;
+        long counter = 0;
+        const int threads = 4, iterations = 20000;
+        std::vector< std::thread > thrs;
+        for ( int t = 0; t < threads; ++t )
+            thrs.emplace_back( [&]() {
+                    for ( int i = 0; i < iterations; ++i ) {
+                        typename Lock::Guard g{ lock };
+                        ++counter;
+                    }
+                } );
+        for ( auto &t : thrs )
+            t.join();
+        assert_eq( counter, long( threads * iterations ), "lost update" );
+        LockStats stats = lock.stats();
+        assert_eq( stats.acquired, uint64_t( threads * iterations ), "acquisitions" );
+        assert_leq( stats.contended, stats.acquired, "contended" );
+    }
+
+    Test flag() {
+        std::atomic_flag flag = ATOMIC_FLAG_INIT;
+        {
+            SpinLock g{ flag };
+            assert( flag.test_and_set(), "flag should be set" );
+        }
+        assert( !flag.test_and_set(), "flag should be clear" );
+    }
+
+    Test ttas() { _exclusion< TTASLock >(); }
+    Test ticket() { _exclusion< TicketLock >(); }
+    Test mcs() { _exclusion< MCSLock >(); }
+
+    Test tryLock() {
+        TTASLock ttas;
+        assert( ttas.try_lock(), "free ttas" );
+        assert( !ttas.try_lock(), "locked ttas" );
+        ttas.unlock();
+        TicketLock ticket;
+        assert( ticket.try_lock(), "free ticket" );
+        assert( !ticket.try_lock(), "locked ticket" );
+        ticket.unlock();
+        assert( ticket.try_lock(), "free ticket again" );
+        ticket.unlock();
+        assert_eq( ticket.stats().acquired, uint64_t( 2 ), "stats" );
+    }
+};
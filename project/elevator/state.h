@@ -1,11 +1,12 @@
 #include <climits>
-#include <unordered_map>
+#include <vector>
+#include <algorithm>
 #include <tuple>
-#include <mutex>
 
 #include <elevator/driver.h>
 #include <elevator/serialization.h>
 #include <elevator/floorset.h>
+#include <elevator/sharedblock.h>
 
 #ifndef SRC_STATE_H
 #define SRC_STATE_H
@@ -29,7 +30,8 @@ enum class ChangeType {
 
 struct ElevatorState {
 
-    using Tuple = std::tuple< int, int, int, Direction, bool, bool, FloorSet, FloorSet, FloorSet >;
+    using Tuple = std::tuple< int, int, int, Direction, bool, bool,
+                              FloorSet, FloorSet, FloorSet, FloorSet >;
 
     ElevatorState( Tuple tuple ) :
         id( std::get< 0 >( tuple ) ),
@@ -40,7 +42,8 @@ struct ElevatorState {
         doorOpen( std::get< 5 >( tuple ) ),
         insideButtons( std::get< 6 >( tuple ) ),
         upButtons( std::get< 7 >( tuple ) ),
-        downButtons( std::get< 8 >( tuple ) )
+        downButtons( std::get< 8 >( tuple ) ),
+        destinations( std::get< 9 >( tuple ) )
     { }
     ElevatorState() : id( INT_MIN ), timestamp( 0 ), lastFloor( INT_MIN ),
         direction( Direction::None ), stopped( false ), doorOpen( true )
@@ -48,7 +51,7 @@ struct ElevatorState {
 
     Tuple tuple() const {
         return std::make_tuple( id, timestamp, lastFloor, direction,
-                stopped, doorOpen, insideButtons, upButtons, downButtons );
+                stopped, doorOpen, insideButtons, upButtons, downButtons, destinations );
     }
 
     void assertConsistency( const BasicDriverInfo &bi ) const {
@@ -56,6 +59,7 @@ struct ElevatorState {
         assert( insideButtons.consistent( bi ), "invalid floor set" );
         assert( upButtons.consistent( bi ), "invalid floor set" );
         assert( downButtons.consistent( bi ), "invalid floor set" );
+        assert( destinations.consistent( bi ), "invalid floor set" );
         assert_leq( bi.minFloor(), lastFloor, "invalid lastFloor" );
         assert( direction == Direction::Up || direction == Direction::Down
             || direction == Direction::None, "invalid direction" );
@@ -70,6 +74,37 @@ struct ElevatorState {
     FloorSet insideButtons;
     FloorSet upButtons;
     FloorSet downButtons;
+    // destination dispatch: destinations of passengers assigned to this
+    // elevator which were not picked up yet
+    FloorSet destinations;
+};
+
+/* passenger registered destination at landing panel (destination dispatch
+ * mode), scheduler assigns passengers to elevators in batches */
+struct DestinationCall {
+    using Tuple = std::tuple< int, int >;
+
+    DestinationCall() : origin( INT_MIN ), destination( INT_MIN ) { }
+    DestinationCall( int origin, int destination ) :
+        origin( origin ), destination( destination )
+    { }
+    explicit DestinationCall( Tuple tuple ) :
+        DestinationCall( std::get< 0 >( tuple ), std::get< 1 >( tuple ) )
+    { }
+
+    Tuple tuple() const { return std::make_tuple( origin, destination ); }
+    static constexpr serialization::TypeSignature type() {
+        return serialization::TypeSignature::DestinationCall;
+    }
+
+    /** hall call passenger would make without destination dispatch */
+    Button pickup() const {
+        return Button( destination > origin ? ButtonType::CallUp : ButtonType::CallDown,
+                origin );
+    }
+
+    int origin;
+    int destination;
 };
 
 struct StateChange {
@@ -87,62 +122,169 @@ struct StateChange {
         return serialization::TypeSignature::ElevatorState;
     }
 
+    /* for queue coalescing: keep-alive carries no information except for
+     * state, so older one is superseded by newer one from same elevator, all
+     * other changes must be delivered */
+    static long coalesceKey( const StateChange &change ) {
+        return change.changeType == ChangeType::KeepAlive ? change.state.id : -1;
+    }
+
 
     ChangeType changeType;
     int changeFloor;
     ElevatorState state;
 };
 
-struct GlobalState {
-    void update( ElevatorState state ) {
-        Guard g{ _lock };
-        _elevators[ state.id ] = state;
-        updateButtons( g );
-    }
+/* states of all elevators stored as structure of arrays indexed by elevator
+ * id (ids are assigned densely from 0 by SessionManager), so that scheduler
+ * can evaluate cost of all elevators by linear pass over few arrays
+ */
+struct FleetTable {
+
+    /** ids are in range [0, size()), not all of them need to be present */
+    int size() const { return int( present.size() ); }
 
-    FloorSet upButtons() const { return _upButtons; }
-    FloorSet downButtons() const { return _downButtons; }
-    std::unordered_map< int, ElevatorState > elevators() const {
-        Guard g{ _lock };
-        return _elevators;
+    bool has( int id ) const {
+        return id >= 0 && id < size() && present[ id ];
     }
 
-    bool has( int i ) const {
-        Guard g{ _lock };
-        return _elevators.find( i ) != _elevators.end();
+    ElevatorState get( int id ) const {
+        assert( has( id ), "state not found" );
+        ElevatorState st;
+        st.id = id;
+        st.timestamp = timestamp[ id ];
+        st.lastFloor = lastFloor[ id ];
+        st.direction = direction[ id ];
+        st.stopped = stopped[ id ];
+        st.doorOpen = doorOpen[ id ];
+        st.insideButtons = insideButtons[ id ];
+        st.upButtons = upButtons[ id ];
+        st.downButtons = downButtons[ id ];
+        st.destinations = destinations[ id ];
+        return st;
     }
 
-    ElevatorState get( int i ) const {
-        Guard g{ _lock };
-        auto it = _elevators.find( i );
-        assert_neq( it, _elevators.end(), "state not found" );
-        return it->second;
+    void set( const ElevatorState &st ) {
+        assert_leq( 0, st.id, "invalid elevator id" );
+        if ( st.id >= size() )
+            _resize( st.id + 1 );
+        present[ st.id ] = true;
+        timestamp[ st.id ] = st.timestamp;
+        lastFloor[ st.id ] = st.lastFloor;
+        direction[ st.id ] = st.direction;
+        stopped[ st.id ] = st.stopped;
+        doorOpen[ st.id ] = st.doorOpen;
+        insideButtons[ st.id ] = st.insideButtons;
+        upButtons[ st.id ] = st.upButtons;
+        downButtons[ st.id ] = st.downButtons;
+        destinations[ st.id ] = st.destinations;
     }
 
-    void assertConsistency( const BasicDriverInfo &bi ) const {
-        Guard g{ _lock };
-        assert( _upButtons.consistent( bi ), "consistency check failed" );
-        assert( _upButtons.consistent( bi ), "consistency check failed" );
-        for ( auto &e : _elevators )
-            e.second.assertConsistency( bi );
+    /** number of present elevators */
+    int count() const {
+        return int( std::count( present.begin(), present.end(), true ) );
     }
 
+    // char instead of bool to avoid std::vector< bool >
+    std::vector< char > present;
+    std::vector< long > timestamp;
+    std::vector< int > lastFloor;
+    std::vector< Direction > direction;
+    std::vector< char > stopped;
+    std::vector< char > doorOpen;
+    std::vector< FloorSet > insideButtons;
+    std::vector< FloorSet > upButtons;
+    std::vector< FloorSet > downButtons;
+    std::vector< FloorSet > destinations;
+
   private:
-    using Guard = std::unique_lock< std::mutex >;
-    mutable std::mutex _lock;
-    FloorSet _upButtons;
-    FloorSet _downButtons;
-    std::unordered_map< int, ElevatorState > _elevators;
-
-    void updateButtons( Guard & ) {
-        _upButtons.reset();
-        _downButtons.reset();
-        for ( const auto &el : _elevators ) {
-            _upButtons |= el.second.upButtons;
-            _downButtons |= el.second.downButtons;
+    void _resize( int n ) {
+        present.resize( n, false );
+        timestamp.resize( n, 0 );
+        lastFloor.resize( n, INT_MIN );
+        direction.resize( n, Direction::None );
+        stopped.resize( n, false );
+        doorOpen.resize( n, true );
+        insideButtons.resize( n );
+        upButtons.resize( n );
+        downButtons.resize( n );
+        destinations.resize( n );
+    }
+};
+
+/* state of all elevators as seen by scheduler, updates are published as new
+ * immutable versions so readers can use snapshot without locking or copying
+ * (see RcuBlock), aggregated buttons are maintained by per-floor counts so
+ * aggregate queries are O(1) and counts are adjusted only by changed buttons
+ *
+ * Publishing new version still copies whole Data (fleet table and counts),
+ * so update is O(elevators), although without allocation as storage of
+ * reclaimed versions is reused. This is trade-off for zero-copy lock-free
+ * snapshots over flat arrays which scheduler scans for each decision (a few
+ * kilobytes for hundreds of cars); sharing unchanged parts between versions
+ * would need per-car indirection in each of these scans.
+ */
+struct GlobalState {
+
+    struct Data {
+        FleetTable fleet;
+        // outstanding calls of all elevators
+        FloorCounts upCalls;
+        FloorCounts downCalls;
+
+        FloorSet upButtons() const { return upCalls.floors(); }
+        FloorSet downButtons() const { return downCalls.floors(); }
+
+        void update( const ElevatorState &state ) {
+            if ( fleet.has( state.id ) ) {
+                upCalls.update( fleet.upButtons[ state.id ], state.upButtons );
+                downCalls.update( fleet.downButtons[ state.id ], state.downButtons );
+            } else {
+                upCalls.add( state.upButtons );
+                downCalls.add( state.downButtons );
+            }
+            fleet.set( state );
         }
+    };
+
+    using Snapshot = RcuBlock< Data >::Snapshot;
+
+    void update( ElevatorState state ) {
+        _data.atomically( [&]( Data &data ) { data.update( state ); } );
     }
 
+    /** consistent view of whole state, lock-free and without copying,
+     * do not hold it for long */
+    Snapshot snapshot() const { return _data.snapshot(); }
+
+    /** changes with each update */
+    unsigned version() const { return _data.version(); }
+
+    FloorSet upButtons() const { return _data.snapshot()->upButtons(); }
+    FloorSet downButtons() const { return _data.snapshot()->downButtons(); }
+    std::vector< ElevatorState > elevators() const {
+        auto snap = _data.snapshot();
+        std::vector< ElevatorState > out;
+        for ( int i = 0; i < snap->fleet.size(); ++i )
+            if ( snap->fleet.has( i ) )
+                out.push_back( snap->fleet.get( i ) );
+        return out;
+    }
+
+    bool has( int i ) const { return _data.snapshot()->fleet.has( i ); }
+    ElevatorState get( int i ) const { return _data.snapshot()->fleet.get( i ); }
+
+    void assertConsistency( const BasicDriverInfo &bi ) const {
+        auto snap = _data.snapshot();
+        assert( snap->upButtons().consistent( bi ), "consistency check failed" );
+        assert( snap->downButtons().consistent( bi ), "consistency check failed" );
+        for ( int i = 0; i < snap->fleet.size(); ++i )
+            if ( snap->fleet.has( i ) )
+                snap->fleet.get( i ).assertConsistency( bi );
+    }
+
+  private:
+    RcuBlock< Data > _data;
 };
 
 }
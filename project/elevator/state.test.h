@@ -2,6 +2,8 @@
 #include <elevator/test.h>
 #include <elevator/serialization.h>
 #include <elevator/udptools.h>
+#include <thread>
+#include <atomic>
 
 struct TestState {
 
@@ -11,4 +13,93 @@ struct TestState {
         auto st2 = serialization::Serializer::fromPacket< elevator::StateChange >( pck );
     }
 
+    static elevator::ElevatorState _state( int id, int up, int down ) {
+        elevator::ElevatorState st;
+        st.id = id;
+        st.lastFloor = 1;
+        elevator::BasicDriverInfo bi{ 1, 4 };
+        if ( up )
+            st.upButtons.set( true, up, bi );
+        if ( down )
+            st.downButtons.set( true, down, bi );
+        return st;
+    }
+
+    Test globalAggregates() {
+        elevator::BasicDriverInfo bi{ 1, 4 };
+        elevator::GlobalState global;
+        global.update( _state( 0, 1, 0 ) );
+        global.update( _state( 1, 2, 3 ) );
+        assert( global.upButtons().get( 1, bi ), "up 1" );
+        assert( global.upButtons().get( 2, bi ), "up 2" );
+        assert( global.downButtons().get( 3, bi ), "down 3" );
+
+        global.update( _state( 1, 0, 0 ) ); // cleared by elevator 1
+        assert( global.upButtons().get( 1, bi ), "up 1 still set by 0" );
+        assert( !global.upButtons().get( 2, bi ), "up 2 cleared" );
+        assert( !global.downButtons().hasAny(), "down cleared" );
+        global.assertConsistency( bi );
+    }
+
+    Test globalCounts() {
+        elevator::BasicDriverInfo bi{ 1, 4 };
+        elevator::GlobalState global;
+        global.update( _state( 0, 2, 0 ) );
+        global.update( _state( 1, 2, 0 ) );
+        global.update( _state( 2, 2, 4 ) );
+        assert_eq( global.snapshot()->upCalls.count( 2, bi ), 3u, "count" );
+        global.update( _state( 0, 0, 0 ) );
+        global.update( _state( 1, 3, 0 ) );
+        assert( global.upButtons().get( 2, bi ), "still called by 2" );
+        assert( global.upButtons().get( 3, bi ), "called by 1" );
+        global.update( _state( 2, 0, 0 ) );
+        assert( !global.upButtons().get( 2, bi ), "nobody calls" );
+        assert( !global.downButtons().hasAny(), "down cleared" );
+        assert_eq( global.snapshot()->upCalls.count( 3, bi ), 1u, "count" );
+    }
+
+    Test globalSnapshot() {
+        elevator::GlobalState global;
+        global.update( _state( 0, 0, 0 ) );
+        unsigned v = global.version();
+        auto snap = global.snapshot();
+        for ( int i = 1; i < 100; ++i )
+            global.update( _state( i, 0, 0 ) );
+        // old snapshot must stay valid and unchanged
+        assert_eq( snap->fleet.count(), 1, "snapshot changed" );
+        assert_eq( global.snapshot()->fleet.count(), 100, "update lost" );
+        assert_neq( global.version(), v, "version" );
+    }
+
+    Test fleetTable() {
+        elevator::FleetTable fleet;
+        assert( !fleet.has( 0 ), "empty" );
+        fleet.set( _state( 2, 3, 0 ) );
+        assert_eq( fleet.size(), 3, "size" );
+        assert_eq( fleet.count(), 1, "count" );
+        assert( !fleet.has( 1 ), "1 not present" );
+        elevator::ElevatorState st = fleet.get( 2 );
+        assert_eq( st.id, 2, "id" );
+        assert_eq( st.lastFloor, 1, "lastFloor" );
+        assert( st.upButtons == _state( 2, 3, 0 ).upButtons, "buttons" );
+    }
+
+    Test globalConcurrent() {
+        elevator::GlobalState global;
+        std::atomic< bool > done{ false };
+        std::thread writer( [&]() {
+                for ( int i = 0; i < 20000; ++i )
+                    global.update( _state( i % 8, 0, 0 ) );
+                done = true;
+            } );
+        while ( !done ) {
+            auto snap = global.snapshot();
+            for ( int i = 0; i < snap->fleet.size(); ++i )
+                if ( snap->fleet.has( i ) )
+                    assert_eq( snap->fleet.lastFloor[ i ], 1, "corrupted snapshot" );
+        }
+        writer.join();
+        assert_eq( global.elevators().size(), 8ul, "final state" );
+    }
+
 };
@@ -1,5 +1,22 @@
 #include <chrono>
 #include <cstdint>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <ctime>
+
+/* Time source for all timing of elevator (heart beats, door timeouts,
+ * keep-alives, queue timeouts).
+ *
+ * By default real (steady) clock is used, but it can be replaced by scaled
+ * clock (time runs faster or slower than real time) or manual clock (time
+ * moves only when advanced explicitly) so that long scenarios can be run
+ * quickly and deterministically. Clock should be replaced before any
+ * component which uses it is started (see ScopedClock).
+ *
+ * Code which waits for some time must not use real time primitives
+ * directly, it should use sleepFor, waitFor or Clock::realWait.
+ */
 
 #ifndef SRC_TIME_H
 #define SRC_TIME_H
@@ -8,9 +25,145 @@ namespace elevator {
 
 using MillisecondTime = int64_t;
 
+namespace _internal {
+/* local wall-clock time of day in milliseconds since midnight */
+inline MillisecondTime wallTimeOfDay() {
+    const auto sys = std::chrono::system_clock::now();
+    const std::time_t t = std::chrono::system_clock::to_time_t( sys );
+    std::tm local;
+    localtime_r( &t, &local );
+    const MillisecondTime ms = std::chrono::duration_cast< std::chrono::milliseconds >(
+            sys.time_since_epoch() ).count() % 1000;
+    return ( ( local.tm_hour * 60 + local.tm_min ) * 60 + local.tm_sec ) * MillisecondTime( 1000 ) + ms;
+}
+}
+
+struct Clock {
+    static constexpr MillisecondTime day = 24 * 3600 * 1000;
+
+    Clock() : _dayOffset( 0 ) { }
+    virtual ~Clock() { }
+
+    /** current time in milliseconds, monotonic, arbitrary epoch */
+    virtual MillisecondTime now() const = 0;
+
+    /** for how long (in real time) to wait if we need to wait for given time
+     * of this clock, waiting must be done in loop which re-checks now() */
+    virtual std::chrono::microseconds realWait( MillisecondTime ) const = 0;
+
+    /** time of day (milliseconds since midnight) at given time of this
+     * clock, real and scaled clock follow local wall-clock time from their
+     * creation, manual clock starts at midnight unless set otherwise */
+    MillisecondTime timeOfDay( MillisecondTime t ) const {
+        return ( ( t + _dayOffset.load( std::memory_order_relaxed ) ) % day + day ) % day;
+    }
+
+  protected:
+    std::atomic< MillisecondTime > _dayOffset; // time of day at time 0
+};
+
+struct RealClock : Clock {
+    RealClock() { _dayOffset = _internal::wallTimeOfDay() - now(); }
+
+    MillisecondTime now() const override {
+        return std::chrono::duration_cast< std::chrono::milliseconds >(
+                std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+
+    std::chrono::microseconds realWait( MillisecondTime ms ) const override {
+        return std::chrono::milliseconds( ms );
+    }
+
+    static RealClock &instance() {
+        static RealClock clock;
+        return clock;
+    }
+};
+
+/* time runs scale times faster than real time (starting at 0) */
+struct ScaledClock : Clock {
+    explicit ScaledClock( double scale ) : _scale( scale ), _start( _real() ) {
+        _dayOffset = _internal::wallTimeOfDay();
+    }
+
+    MillisecondTime now() const override {
+        return MillisecondTime( ( _real() - _start ) * _scale / 1000 );
+    }
+
+    std::chrono::microseconds realWait( MillisecondTime ms ) const override {
+        return std::chrono::microseconds( int64_t( ms * 1000 / _scale ) + 1 );
+    }
+
+  private:
+    const double _scale;
+    const int64_t _start;
+
+    static int64_t _real() {
+        return std::chrono::duration_cast< std::chrono::microseconds >(
+                std::chrono::steady_clock::now().time_since_epoch() ).count();
+    }
+};
+
+/* time moves only by calling advance, waiting threads poll it */
+struct ManualClock : Clock {
+    explicit ManualClock( MillisecondTime start = 0 ) : _time( start ) { }
+
+    MillisecondTime now() const override {
+        return _time.load( std::memory_order_acquire );
+    }
+
+    std::chrono::microseconds realWait( MillisecondTime ) const override {
+        return std::chrono::microseconds( int64_t( _pollInterval ) );
+    }
+
+    void advance( MillisecondTime delta ) {
+        _time.fetch_add( delta, std::memory_order_acq_rel );
+    }
+
+    /** time of day (milliseconds since midnight) corresponding to now() */
+    void setTimeOfDay( MillisecondTime timeOfDay ) {
+        _dayOffset.store( timeOfDay - now(), std::memory_order_relaxed );
+    }
+
+  private:
+    static const int64_t _pollInterval = 200; // µs
+    std::atomic< MillisecondTime > _time;
+};
+
+namespace _internal {
+inline std::atomic< Clock * > &clockSlot() {
+    static std::atomic< Clock * > slot{ &RealClock::instance() };
+    return slot;
+}
+}
+
+/** currently used clock */
+inline Clock &currentClock() {
+    return *_internal::clockSlot().load( std::memory_order_acquire );
+}
+
+inline void setClock( Clock &clock ) {
+    _internal::clockSlot().store( &clock, std::memory_order_release );
+}
+
+/* replace clock for lifetime of this object */
+struct ScopedClock {
+    explicit ScopedClock( Clock &clock ) : _orig( &currentClock() ) { setClock( clock ); }
+    ScopedClock( const ScopedClock & ) = delete;
+    ~ScopedClock() { setClock( *_orig ); }
+
+  private:
+    Clock *_orig;
+};
+
 static inline MillisecondTime now() {
-    return std::chrono::duration_cast< std::chrono::milliseconds >(
-            std::chrono::steady_clock::now().time_since_epoch() ).count();
+    return currentClock().now();
+}
+
+/** time of day (milliseconds since midnight) by current clock */
+static inline MillisecondTime timeOfDay() {
+    const Clock &c = currentClock();
+    return c.timeOfDay( c.now() );
 }
 
 static inline std::chrono::milliseconds toSystemTime( MillisecondTime mtime ) {
@@ -22,6 +175,43 @@ static MillisecondTime fromSystemTime( const std::chrono::duration< Rep, Period
     return std::chrono::duration_cast< std::chrono::milliseconds >( d ).count();
 }
 
+/** sleep for given time of current clock */
+static inline void sleepFor( MillisecondTime ms ) {
+    Clock &c = currentClock();
+    MillisecondTime deadline = c.now() + ms;
+    for ( MillisecondTime remaining = ms; remaining > 0; remaining = deadline - c.now() )
+        std::this_thread::sleep_for( c.realWait( remaining ) );
+}
+
+/** wait on condition variable until predicate holds or given time of current
+ * clock elapses (ms < 0 means no timeout), returns value of predicate */
+template< typename Lock, typename Predicate >
+static bool waitFor( std::condition_variable &cond, Lock &lock,
+        MillisecondTime ms, Predicate pred )
+{
+    if ( ms < 0 ) {
+        cond.wait( lock, pred );
+        return true;
+    }
+    Clock &c = currentClock();
+    MillisecondTime deadline = c.now() + ms;
+    while ( !pred() ) {
+        MillisecondTime remaining = deadline - c.now();
+        if ( remaining <= 0 )
+            return false;
+        cond.wait_for( lock, c.realWait( remaining ) );
+    }
+    return true;
+}
+
+/** CPU time consumed by calling thread in nanoseconds (real CPU time, not
+ * related to elevator clock), for measuring cost of computations */
+static inline int64_t threadCpuTime() {
+    struct timespec ts;
+    clock_gettime( CLOCK_THREAD_CPUTIME_ID, &ts );
+    return int64_t( ts.tv_sec ) * 1000000000 + ts.tv_nsec;
+}
+
 }
 
 #endif // SRC_TIME_H
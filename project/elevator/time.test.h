@@ -0,0 +1,95 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/time.h>
+#include <elevator/heartbeat.h>
+#include <elevator/concurrentqueue.h>
+#include <elevator/test.h>
+#include <thread>
+
+using namespace elevator;
+
+struct TestTime {
+    Test manual() {
+        ManualClock clock{ 100 };
+        ScopedClock scope{ clock };
+        assert_eq( now(), 100, "start" );
+        clock.advance( 50 );
+        assert_eq( now(), 150, "advance" );
+    }
+
+    Test timeOfDay() {
+        const MillisecondTime hour = 3600 * 1000;
+        ManualClock clock{ 100 };
+        ScopedClock scope{ clock };
+        assert_eq( elevator::timeOfDay(), 100, "manual clock starts at midnight" );
+        clock.setTimeOfDay( 8 * hour );
+        assert_eq( elevator::timeOfDay(), 8 * hour, "set" );
+        clock.advance( 17 * hour );
+        assert_eq( elevator::timeOfDay(), hour, "wraps at midnight" );
+        assert_eq( clock.timeOfDay( 100 ), 8 * hour, "at given time" );
+    }
+
+    Test scoped() {
+        MillisecondTime real = now();
+        {
+            ManualClock clock;
+            ScopedClock scope{ clock };
+            assert_eq( now(), 0, "manual clock" );
+        }
+        assert_leq( real, now(), "real clock restored" );
+    }
+
+    Test scaled() {
+        ScaledClock clock{ 1000 };
+        ScopedClock scope{ clock };
+        MillisecondTime start = now();
+        sleepFor( 2000 ); // 2 ms of real time
+        assert_leq( start + 2000, now(), "sleep" );
+    }
+
+    Test manualSleep() {
+        ManualClock clock;
+        ScopedClock scope{ clock };
+        std::atomic< bool > woken{ false };
+        std::thread thr( [&]() { sleepFor( 1000 ); woken = true; } );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+        assert( !woken, "woken without advancing clock" );
+        clock.advance( 1000 );
+        thr.join();
+        assert( woken, "not woken" );
+    }
+
+    Test heartBeat() {
+        ManualClock clock;
+        ScopedClock scope{ clock };
+        HeartBeat hb( 100 );
+        hb.beat();
+        clock.advance( 100 );
+        assert( hb.check(), "in time" );
+        clock.advance( 1 );
+        assert( !hb.check(), "late" );
+    }
+
+    template< typename Queue >
+    void _queueTimeout( Queue &q ) {
+        ManualClock clock;
+        ScopedClock scope{ clock };
+        std::atomic< bool > done{ false };
+        std::thread thr( [&]() {
+                int x;
+                assert( !q.timeoutDequeue( x, 1000 ), "dequeued from empty queue" );
+                done = true;
+            } );
+        std::this_thread::sleep_for( std::chrono::milliseconds( 5 ) );
+        assert( !done, "timeout without advancing clock" );
+        clock.advance( 1000 );
+        thr.join();
+    }
+
+    Test queueTimeout() {
+        ConcurrentQueue< int > locked;
+        _queueTimeout( locked );
+        ConcurrentQueue< int > lockFree{ QueueBackend::LockFree };
+        _queueTimeout( lockFree );
+    }
+};
@@ -0,0 +1,57 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/traffic.h>
+#include <elevator/test.h>
+
+#include <algorithm>
+
+namespace elevator {
+
+constexpr MillisecondTime TrafficModel::day;
+constexpr double TrafficModel::_ageLimit;
+constexpr double TrafficModel::_nextWeight;
+
+TrafficModel::TrafficModel( BasicDriverInfo bounds, int buckets ) :
+    _bounds( bounds ), _buckets( buckets ),
+    _floors( bounds.maxFloor() - bounds.minFloor() + 1 ),
+    _counts( buckets * _floors, 0 ), _totals( buckets, 0 )
+{
+    assert_lt( 0, buckets, "at least one bucket needed" );
+}
+
+int TrafficModel::_bucket( MillisecondTime timeOfDay ) const {
+    const MillisecondTime t = ( timeOfDay % day + day ) % day;
+    return int( t * _buckets / day );
+}
+
+void TrafficModel::record( int floor, MillisecondTime timeOfDay ) {
+    assert_leq( _bounds.minFloor(), floor, "floor out of bounds" );
+    assert_leq( floor, _bounds.maxFloor(), "floor out of bounds" );
+    const int b = _bucket( timeOfDay );
+    _count( b, floor ) += 1;
+    if ( ++_totals[ b ] > _ageLimit ) {
+        for ( int f = _bounds.minFloor(); f <= _bounds.maxFloor(); ++f )
+            _count( b, f ) /= 2;
+        _totals[ b ] /= 2;
+    }
+}
+
+double TrafficModel::rate( int floor, MillisecondTime timeOfDay ) const {
+    const int b = _bucket( timeOfDay );
+    return _count( b, floor ) + _nextWeight * _count( ( b + 1 ) % _buckets, floor );
+}
+
+std::vector< int > TrafficModel::hotFloors( MillisecondTime timeOfDay, int count ) const {
+    std::vector< int > floors;
+    for ( int f = _bounds.minFloor(); f <= _bounds.maxFloor(); ++f )
+        if ( rate( f, timeOfDay ) > 0 )
+            floors.push_back( f );
+    std::stable_sort( floors.begin(), floors.end(), [&]( int a, int b ) {
+            return rate( a, timeOfDay ) > rate( b, timeOfDay );
+        } );
+    if ( int( floors.size() ) > count )
+        floors.resize( std::max( count, 0 ) );
+    return floors;
+}
+
+}
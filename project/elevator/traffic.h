@@ -0,0 +1,58 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Traffic pattern learning for predictive parking
+ *
+ * Day is split into time buckets, for each bucket and floor model counts hall
+ * calls which arrived at that time of day. Counts of bucket are halved when
+ * they grow too large so that model follows changes of traffic over days.
+ * Floors with most expected calls in current (and next) bucket are hot
+ * floors, scheduler parks idle cars there. Time of day is taken from
+ * elevator clock by caller (see timeOfDay in elevator/time.h).
+ */
+
+#include <elevator/driver.h>
+#include <elevator/time.h>
+
+#include <vector>
+
+#ifndef SRC_TRAFFIC_H
+#define SRC_TRAFFIC_H
+
+namespace elevator {
+
+struct TrafficModel {
+    static constexpr MillisecondTime day = Clock::day;
+
+    explicit TrafficModel( BasicDriverInfo, int buckets = 96 /* 15 minutes */ );
+
+    /** hall call at floor arrived at given time of day */
+    void record( int floor, MillisecondTime timeOfDay );
+
+    /** relative expected number of calls at floor around given time of day */
+    double rate( int floor, MillisecondTime timeOfDay ) const;
+
+    /** at most count floors with nonzero rate ordered by decreasing rate */
+    std::vector< int > hotFloors( MillisecondTime timeOfDay, int count ) const;
+
+  private:
+    BasicDriverInfo _bounds;
+    const int _buckets;
+    const int _floors;
+    std::vector< double > _counts; // [ bucket * _floors + floor - minFloor ]
+    std::vector< double > _totals; // per bucket
+
+    int _bucket( MillisecondTime timeOfDay ) const;
+    double &_count( int bucket, int floor ) {
+        return _counts[ bucket * _floors + floor - _bounds.minFloor() ];
+    }
+    double _count( int bucket, int floor ) const {
+        return _counts[ bucket * _floors + floor - _bounds.minFloor() ];
+    }
+
+    static constexpr double _ageLimit = 1000; // calls per bucket before halving
+    static constexpr double _nextWeight = 0.5; // upcoming bucket in rate
+};
+
+}
+
+#endif // SRC_TRAFFIC_H
@@ -0,0 +1,53 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/traffic.h>
+#include <elevator/test.h>
+
+using namespace elevator;
+
+struct TestTraffic {
+
+    BasicDriverInfo bi{ 1, 6 };
+    static constexpr MillisecondTime hour = 3600 * 1000;
+
+    Test hotFloors() {
+        TrafficModel model{ bi, 24 };
+        assert( model.hotFloors( 8 * hour, 2 ).empty(), "no data" );
+
+        // morning: lobby, evening: offices
+        for ( int i = 0; i < 10; ++i )
+            model.record( 1, 8 * hour + i );
+        model.record( 4, 8 * hour );
+        for ( int i = 0; i < 5; ++i )
+            model.record( 5, 17 * hour + i );
+
+        auto morning = model.hotFloors( 8 * hour + hour / 2, 2 );
+        assert_eq( morning.size(), 2ul, "hot floors" );
+        assert_eq( morning[ 0 ], 1, "lobby first" );
+        assert_eq( morning[ 1 ], 4, "hot floors" );
+        assert_eq( model.hotFloors( 8 * hour, 1 ).size(), 1ul, "limited" );
+
+        // upcoming traffic is predicted from next bucket
+        auto before = model.hotFloors( 16 * hour + hour / 2, 3 );
+        assert_eq( before.size(), 1ul, "next bucket" );
+        assert_eq( before[ 0 ], 5, "next bucket" );
+    }
+
+    Test wrap() {
+        TrafficModel model{ bi, 24 };
+        model.record( 2, TrafficModel::day + hour );
+        assert_lt( 0, model.rate( 2, hour ), "next day" );
+        model.record( 3, 0 );
+        assert_lt( 0, model.rate( 3, TrafficModel::day - 1 ), "next bucket wraps" );
+    }
+
+    Test aging() {
+        TrafficModel model{ bi, 24 };
+        for ( int i = 0; i < 1000; ++i )
+            model.record( 1, hour );
+        for ( int i = 0; i < 600; ++i )
+            model.record( 2, hour );
+        // old lobby traffic decayed, recent traffic on floor 2 dominates
+        assert_lt( model.rate( 1, hour ), model.rate( 2, hour ), "aging" );
+    }
+};
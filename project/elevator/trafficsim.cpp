@@ -0,0 +1,352 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/trafficsim.h>
+#include <elevator/bank.h>
+#include <elevator/scheduler.h>
+#include <elevator/simulator.h>
+#include <elevator/layout.h>
+#include <elevator/test.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <thread>
+
+namespace elevator {
+
+constexpr MillisecondTime Passenger::never;
+
+TrafficPattern trafficPattern( const std::string &name ) {
+    if ( name == "up-peak" )
+        return TrafficPattern::UpPeak;
+    if ( name == "down-peak" )
+        return TrafficPattern::DownPeak;
+    if ( name == "inter-floor" )
+        return TrafficPattern::InterFloor;
+    if ( name == "poisson" )
+        return TrafficPattern::Poisson;
+    assert_unreachable( "unknown traffic pattern" );
+}
+
+const char *showPattern( TrafficPattern p ) {
+    switch ( p ) {
+        case TrafficPattern::UpPeak: return "up-peak";
+        case TrafficPattern::DownPeak: return "down-peak";
+        case TrafficPattern::InterFloor: return "inter-floor";
+        case TrafficPattern::Poisson: return "poisson";
+    }
+    return "<<unknown>>";
+}
+
+PassengerGenerator::PassengerGenerator( TrafficPattern pattern, BasicDriverInfo bounds,
+        double perMinute, unsigned seed ) :
+    _pattern( pattern ), _bounds( bounds ), _headway( 60000 / perMinute ), _time( 0 ),
+    _random( seed )
+{
+    assert_lt( 0, perMinute, "arrival rate must be positive" );
+    assert_lt( bounds.minFloor(), bounds.maxFloor(), "at least two floors needed" );
+}
+
+int PassengerGenerator::_floor( int except ) {
+    // uniformly from all floors but except
+    std::uniform_int_distribution< int > dist( _bounds.minFloor(), _bounds.maxFloor() - 1 );
+    int f = dist( _random );
+    return f >= except ? f + 1 : f;
+}
+
+Passenger PassengerGenerator::_make( TrafficPattern pattern, MillisecondTime arrival ) {
+    const int lobby = _bounds.minFloor();
+    switch ( pattern ) {
+        case TrafficPattern::UpPeak:
+            return Passenger( lobby, _floor( lobby ), arrival );
+        case TrafficPattern::DownPeak:
+            return Passenger( _floor( lobby ), lobby, arrival );
+        case TrafficPattern::InterFloor: {
+            int origin = _floor( INT_MAX );
+            return Passenger( origin, _floor( origin ), arrival );
+        }
+        case TrafficPattern::Poisson: {
+            double r = std::uniform_real_distribution< double >( 0, 1 )( _random );
+            return _make( r < 0.4 ? TrafficPattern::UpPeak
+                        : r < 0.8 ? TrafficPattern::DownPeak
+                                  : TrafficPattern::InterFloor, arrival );
+        }
+    }
+    assert_unreachable( "unknown traffic pattern" );
+}
+
+Passenger PassengerGenerator::next() {
+    if ( _pattern == TrafficPattern::Poisson )
+        _time += std::exponential_distribution< double >( 1 / _headway )( _random );
+    else
+        _time += _headway;
+    return _make( _pattern, MillisecondTime( _time ) );
+}
+
+TimeSummary TimeSummary::of( std::vector< MillisecondTime > sample ) {
+    TimeSummary s;
+    if ( sample.empty() )
+        return s;
+    std::sort( sample.begin(), sample.end() );
+    auto rank = [&]( double p ) {
+        size_t r = size_t( std::ceil( p * sample.size() ) );
+        return sample[ std::max( r, size_t( 1 ) ) - 1 ];
+    };
+    s.count = sample.size();
+    double sum = 0;
+    for ( auto t : sample )
+        sum += t;
+    s.mean = sum / sample.size();
+    s.p95 = rank( 0.95 );
+    s.p99 = rank( 0.99 );
+    s.max = sample.back();
+    return s;
+}
+
+void TrafficSimulation::Report::print( std::ostream &o ) const {
+    const auto flags = o.flags();
+    const auto precision = o.precision();
+    auto times = [&]( const char *name, const TimeSummary &s ) {
+        o << std::setw( 10 ) << name << std::fixed << std::setprecision( 1 )
+          << "  mean " << std::setw( 7 ) << s.mean / 1000 << " s"
+          << "  p95 " << std::setw( 7 ) << s.p95 / 1000.0 << " s"
+          << "  p99 " << std::setw( 7 ) << s.p99 / 1000.0 << " s"
+          << "  max " << std::setw( 7 ) << s.max / 1000.0 << " s" << std::endl;
+    };
+    o << "passengers: " << delivered << " of " << generated << " delivered in "
+      << simulated / 1000 << " s" << std::endl;
+    times( "wait", wait );
+    times( "journey", journey );
+    o << std::setprecision( 2 )
+      << "scheduler: " << decisions << " decisions, " << decisionTime << " µs each; "
+      << rounds << " rounds, " << roundTime << " µs each" << std::endl;
+    o.flags( flags );
+    o.precision( precision );
+}
+
+TrafficSimulation::Report TrafficSimulation::run( Config config ) {
+    const Layout &layout = Layout::current();
+    const BasicDriverInfo bounds( layout.minFloor, layout.maxFloor );
+
+    ManualClock clock{ 0 };
+    clock.setTimeOfDay( config.start );
+    ScopedClock scope{ clock };
+    for ( int i = 0; i < config.cars; ++i ) {
+        lowlevel::Simulator::Config sim;
+        sim.layout = layout;
+        lowlevel::Simulator::device( Bank::deviceName( i ) ).reset( sim );
+    }
+    auto device = [&]( int car ) -> lowlevel::Simulator & {
+        return lowlevel::Simulator::device( Bank::deviceName( car ) );
+    };
+
+    HeartBeatManager heartbeats; // not checked, clock does not run by itself
+    // cars report to carsOut, simulation passes their changes to scheduler
+    // only after all cars finished step (see settle)
+    ConcurrentQueue< StateChange > carsOut, stateIn, stateOut;
+    ConcurrentQueue< Command > remote;
+    std::deque< StateChange > pending; // to be passed to scheduler
+    long passed = 0; // state changes passed to scheduler
+
+    // collect changes cars emitted since last call, order of cars within
+    // step must not depend on thread scheduling
+    auto collect = [&] {
+        std::deque< StateChange > changes = carsOut.dequeueAll();
+        std::stable_sort( changes.begin(), changes.end(),
+                []( const StateChange &a, const StateChange &b ) {
+                    return a.state.id < b.state.id;
+                } );
+        std::move( changes.begin(), changes.end(), std::back_inserter( pending ) );
+    };
+    // scheduler gets changes one by one, so that its periodic work always
+    // sees the same prefix of them
+    auto pass = [&]() -> bool {
+        collect();
+        if ( pending.empty() )
+            return false;
+        stateIn.enqueue( std::move( pending.front() ) );
+        pending.pop_front();
+        ++passed;
+        return true;
+    };
+
+    // threads wait for time of clock, so it must keep running while they are
+    // being stopped (ticker is destructed after bank and scheduler, but
+    // before queues), scheduler is woken by state changes
+    struct Ticker {
+        Ticker() : stop( false ) { }
+        ~Ticker() {
+            stop = true;
+            if ( thread.joinable() )
+                thread.join();
+        }
+        std::atomic< bool > stop;
+        std::thread thread;
+    } ticker;
+
+    // each car does exactly one cycle per step (and one more after commands
+    // of each scheduler iteration); scheduler does not wake up by itself,
+    // only when state changes are passed to it, so that its periodic work
+    // happens at the same time in each run (keep-alives wake it at least
+    // twice a second)
+    Bank bank{ 0, config.cars, heartbeats, carsOut, QueueBackend::Locked,
+               Elevator::PollRate( config.step, config.step ) };
+    Scheduler scheduler{ heartbeats.getNew( 10 * ( config.duration + config.drain ) ),
+                         bank, stateIn, stateOut, remote,
+                         DispatchEngine::create( config.dispatch, bounds ) };
+    bank.run();
+    scheduler.run();
+
+    // wait (in real time) for condition, false if it was not reached in time
+    auto await = []( std::function< bool() > done ) {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds( 10 );
+        while ( !done() ) {
+            if ( std::chrono::steady_clock::now() >= deadline )
+                return false;
+            std::this_thread::yield();
+        }
+        return true;
+    };
+
+    // cars and scheduler take turns until they have nothing to do at
+    // current time: cars finish their cycle and handle all commands, then
+    // one of their state changes is passed to scheduler which handles it
+    // (and possibly sends more commands)
+    auto settle = [&] {
+        const MillisecondTime t = now();
+        for ( ;; ) {
+            assert( await( [&] {
+                    for ( int c = 0; c < config.cars; ++c )
+                        if ( bank.car( c ).lastCycle() < t
+                                || bank.car( c ).handledCommands() < bank.delivered( c ) )
+                            return false;
+                    return true;
+                } ), "cars did not finish simulation step in time" );
+            if ( !pass() )
+                break;
+            assert( await( [&] {
+                    return scheduler.stats().updates == passed && scheduler.handledUntil() >= t;
+                } ), "scheduler did not finish simulation step in time" );
+        }
+    };
+
+    std::vector< ElevatorState > states( config.cars );
+    std::vector< Passenger > passengers;
+    std::vector< int > waiting, riding; // indices to passengers
+    PassengerGenerator generator( config.pattern, bounds, config.perMinute, config.seed );
+    Passenger incoming = generator.next();
+    const MillisecondTime repress = 1000;
+
+    auto press = [&]( int car, Passenger &p, ButtonType type, int floor ) {
+        device( car ).pressButton( layout.buttons[ floor - bounds.minFloor() ][ int( type ) ] );
+        p.lastPress = now();
+    };
+    auto lamp = [&]( int car, ButtonType type, int floor ) {
+        return device( car ).output( layout.lamps[ floor - bounds.minFloor() ][ int( type ) ] );
+    };
+
+    settle(); // first cycle of cars must happen at time 0 in each run
+    while ( now() < config.duration
+            || ( ( !waiting.empty() || !riding.empty() )
+                && now() < config.duration + config.drain ) )
+    {
+        clock.advance( config.step );
+        settle();
+        const MillisecondTime t = now();
+
+        StateChange change;
+        while ( stateOut.tryDequeue( change ) )
+            states[ change.state.id ] = change.state;
+
+        // arrivals, hall button is pressed on panel of some car
+        for ( ; incoming.arrival <= t && incoming.arrival < config.duration;
+                incoming = generator.next() )
+        {
+            waiting.push_back( passengers.size() );
+            passengers.push_back( incoming );
+            Passenger &p = passengers.back();
+            press( waiting.back() % config.cars, p, p.direction(), p.origin );
+        }
+
+        for ( int c = 0; c < config.cars; ++c ) {
+            auto &sim = device( c );
+            const int sensor = sim.sensorFloor();
+            if ( sensor < 0 || !sim.output( layout.doorOpen ) )
+                continue;
+            const int floor = bounds.minFloor() + sensor;
+
+            riding.erase( std::remove_if( riding.begin(), riding.end(), [&]( int i ) {
+                    Passenger &p = passengers[ i ];
+                    if ( p.car != c || p.destination != floor )
+                        return false;
+                    p.delivered = t;
+                    return true;
+                } ), riding.end() );
+
+            const ElevatorState &st = states[ c ];
+            waiting.erase( std::remove_if( waiting.begin(), waiting.end(), [&]( int i ) {
+                    Passenger &p = passengers[ i ];
+                    if ( p.origin != floor )
+                        return false;
+                    const bool up = p.direction() == ButtonType::CallUp;
+                    // car stopped only for call in opposite direction
+                    if ( !( up ? st.upButtons : st.downButtons ).get( floor, bounds )
+                            && ( up ? st.downButtons : st.upButtons ).get( floor, bounds ) )
+                        return false;
+                    p.boarded = t;
+                    p.car = c;
+                    press( c, p, ButtonType::TargetFloor, p.destination );
+                    riding.push_back( i );
+                    return true;
+                } ), waiting.end() );
+        }
+
+        // press again if request was lost (e.g. call cleared by car which
+        // went other way)
+        for ( int i : waiting ) {
+            Passenger &p = passengers[ i ];
+            const int car = i % config.cars;
+            if ( p.lastPress + repress <= t && !lamp( car, p.direction(), p.origin ) )
+                press( car, p, p.direction(), p.origin );
+        }
+        for ( int i : riding ) {
+            Passenger &p = passengers[ i ];
+            if ( p.lastPress + repress <= t && !lamp( p.car, ButtonType::TargetFloor, p.destination ) )
+                press( p.car, p, ButtonType::TargetFloor, p.destination );
+        }
+    }
+
+    Report report;
+    report.simulated = now();
+    ticker.thread = std::thread( [&] {
+            while ( !ticker.stop ) {
+                clock.advance( config.step );
+                while ( pass() ) { }
+                std::this_thread::sleep_for( std::chrono::milliseconds( 1 ) );
+            }
+        } );
+
+    std::vector< MillisecondTime > wait, journey;
+    for ( const auto &p : passengers ) {
+        if ( p.boarded != Passenger::never )
+            wait.push_back( p.boarded - p.arrival );
+        if ( p.delivered != Passenger::never )
+            journey.push_back( p.delivered - p.arrival );
+    }
+    report.generated = passengers.size();
+    report.delivered = journey.size();
+    report.wait = TimeSummary::of( wait );
+    report.journey = TimeSummary::of( journey );
+
+    const Scheduler::Stats stats = scheduler.stats();
+    report.decisions = stats.decisions;
+    report.decisionTime = stats.decisions ? stats.decisionTime / 1000.0 / stats.decisions : 0;
+    report.rounds = stats.rounds;
+    report.roundTime = stats.rounds ? stats.roundTime / 1000.0 / stats.rounds : 0;
+    return report;
+}
+
+}
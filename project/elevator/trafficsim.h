@@ -0,0 +1,141 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Building traffic simulation for benchmarking of scheduling
+ *
+ * Real Bank (Elevator control loops on simulated hardware) and real
+ * Scheduler run on manual clock (see elevator/time.h), simulation advances
+ * clock in fixed steps and after each step lets cars and scheduler take
+ * turns until both handled everything due at that time (cars finished their
+ * cycle and handled all commands, their state changes were passed to
+ * scheduler one by one in order of car ids and it handled each of them
+ * before next one was passed, see Scheduler::handledUntil). Scheduler is
+ * woken only by these state changes and it delivers commands of each
+ * iteration to cars at once, so results (except for measured CPU times)
+ * are repeatable and do not depend on speed of machine; simulation fails if
+ * cars or scheduler do not finish step within 10 s of real time. Passengers
+ * come from PassengerGenerator in order of arrival, they press hall
+ * buttons, board car which opens door at their floor (unless it serves only
+ * opposite direction), press destination button and leave at destination;
+ * buttons are pressed again if their lamp goes off before passenger is
+ * served.
+ *
+ * Reported are wait times (arrival to boarding), journey times (arrival to
+ * destination) and CPU time of scheduler per decision.
+ */
+
+#include <elevator/time.h>
+#include <elevator/driver.h>
+
+#include <climits>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+#include <ostream>
+
+#ifndef SRC_TRAFFICSIM_H
+#define SRC_TRAFFICSIM_H
+
+namespace elevator {
+
+/* up-peak: from lowest floor (lobby) up, down-peak: to lobby, inter-floor:
+ * uniformly between floors, all with constant headway; poisson: exponential
+ * inter-arrival times and mixed traffic (40 % up-peak, 40 % down-peak,
+ * 20 % inter-floor) */
+enum class TrafficPattern { UpPeak, DownPeak, InterFloor, Poisson };
+
+/** pattern by name ("up-peak", "down-peak", "inter-floor", "poisson") */
+TrafficPattern trafficPattern( const std::string & );
+const char *showPattern( TrafficPattern );
+
+struct Passenger {
+    static constexpr MillisecondTime never = INT64_MAX;
+
+    Passenger( int origin, int destination, MillisecondTime arrival ) :
+        origin( origin ), destination( destination ), arrival( arrival ),
+        boarded( never ), delivered( never ), car( INT_MIN ), lastPress( never )
+    { }
+
+    ButtonType direction() const {
+        return destination > origin ? ButtonType::CallUp : ButtonType::CallDown;
+    }
+
+    int origin;
+    int destination;
+    MillisecondTime arrival;
+    MillisecondTime boarded;
+    MillisecondTime delivered;
+    int car;
+    MillisecondTime lastPress;
+};
+
+struct PassengerGenerator {
+    PassengerGenerator( TrafficPattern, BasicDriverInfo, double perMinute, unsigned seed );
+
+    /** next passenger, arrival times are nondecreasing */
+    Passenger next();
+
+  private:
+    TrafficPattern _pattern;
+    BasicDriverInfo _bounds;
+    double _headway; // mean, in ms
+    double _time;
+    std::mt19937 _random;
+
+    int _floor( int except );
+    Passenger _make( TrafficPattern, MillisecondTime );
+};
+
+/* summary of sample of times (in ms) */
+struct TimeSummary {
+    TimeSummary() : count( 0 ), mean( 0 ), p95( 0 ), p99( 0 ), max( 0 ) { }
+
+    /** nearest-rank percentiles */
+    static TimeSummary of( std::vector< MillisecondTime > );
+
+    long count;
+    double mean;
+    MillisecondTime p95, p99, max;
+};
+
+struct TrafficSimulation {
+    struct Config {
+        Config() : cars( 2 ), pattern( TrafficPattern::InterFloor ), perMinute( 6 ),
+            duration( 10 * 60 * 1000 ), drain( 5 * 60 * 1000 ), seed( 1 ),
+            dispatch( "eta" ), step( 20 ), start( 8 * 3600 * 1000 )
+        { }
+
+        int cars;
+        TrafficPattern pattern;
+        double perMinute;         // passenger arrivals
+        MillisecondTime duration; // of arrivals
+        MillisecondTime drain;    // maximal time to serve remaining passengers
+        unsigned seed;
+        std::string dispatch;     // see DispatchEngine::create
+        MillisecondTime step;     // of simulated clock
+        MillisecondTime start;    // time of day at which simulation starts
+    };
+
+    struct Report {
+        long generated;
+        long delivered;
+        MillisecondTime simulated;
+        TimeSummary wait;
+        TimeSummary journey;
+        long decisions;
+        double decisionTime; // mean, in µs
+        long rounds;
+        double roundTime;    // mean, in µs
+
+        void print( std::ostream & ) const;
+    };
+
+    /** run simulation with building layout Layout::current() and simulated
+     * devices Bank::deviceName( 0 .. cars - 1 ), replaces clock while
+     * running */
+    static Report run( Config );
+};
+
+}
+
+#endif // SRC_TRAFFICSIM_H
@@ -0,0 +1,79 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+#include <elevator/trafficsim.h>
+#include <elevator/test.h>
+
+using namespace elevator;
+
+struct TestTrafficSim {
+
+    Test summary() {
+        std::vector< MillisecondTime > sample;
+        for ( int i = 100; i >= 1; --i )
+            sample.push_back( i );
+        auto s = TimeSummary::of( sample );
+        assert_eq( s.count, 100, "count" );
+        assert_eq( s.mean, 50.5, "mean" );
+        assert_eq( s.p95, 95, "p95" );
+        assert_eq( s.p99, 99, "p99" );
+        assert_eq( s.max, 100, "max" );
+        assert_eq( TimeSummary::of( { 7 } ).p99, 7, "single" );
+        assert_eq( TimeSummary::of( { } ).count, 0, "empty" );
+    }
+
+    Test generators() {
+        BasicDriverInfo bi{ 1, 6 };
+        for ( auto pattern : { TrafficPattern::UpPeak, TrafficPattern::DownPeak,
+                TrafficPattern::InterFloor, TrafficPattern::Poisson } )
+        {
+            PassengerGenerator gen( pattern, bi, 60, 42 );
+            MillisecondTime last = 0;
+            for ( int i = 0; i < 1000; ++i ) {
+                Passenger p = gen.next();
+                assert_leq( last, p.arrival, "arrivals are ordered" );
+                assert_neq( p.origin, p.destination, "passenger travels" );
+                assert_leq( bi.minFloor(), std::min( p.origin, p.destination ), "bounds" );
+                assert_leq( std::max( p.origin, p.destination ), bi.maxFloor(), "bounds" );
+                if ( pattern == TrafficPattern::UpPeak )
+                    assert_eq( p.origin, 1, "up-peak starts in lobby" );
+                if ( pattern == TrafficPattern::DownPeak )
+                    assert_eq( p.destination, 1, "down-peak ends in lobby" );
+                last = p.arrival;
+            }
+            // 1000 passengers, one per second on average
+            assert_leq( 900 * 1000, last, "rate" );
+            assert_leq( last, 1100 * 1000, "rate" );
+        }
+    }
+
+    Test simulate() {
+        TrafficSimulation::Config config;
+        config.duration = 2 * 60 * 1000;
+        auto report = TrafficSimulation::run( config );
+        assert_lt( 0, report.generated, "passengers" );
+        assert_eq( report.delivered, report.generated, "all served" );
+        assert_leq( report.wait.mean, report.journey.mean, "wait is part of journey" );
+        assert_leq( report.journey.p95, report.journey.max, "percentiles" );
+        assert_leq( 1, report.decisions, "scheduler decisions measured" );
+    }
+
+    Test repeatable() {
+        TrafficSimulation::Config config;
+        config.pattern = TrafficPattern::Poisson;
+        config.duration = 2 * 60 * 1000;
+        auto a = TrafficSimulation::run( config );
+        auto b = TrafficSimulation::run( config );
+        auto same = []( const TimeSummary &x, const TimeSummary &y ) {
+            return x.count == y.count && x.mean == y.mean && x.p95 == y.p95
+                && x.p99 == y.p99 && x.max == y.max;
+        };
+        // CPU times are measured, everything else must be identical
+        assert_eq( a.generated, b.generated, "same passengers" );
+        assert_eq( a.delivered, b.delivered, "same passengers" );
+        assert_eq( a.simulated, b.simulated, "same duration" );
+        assert( same( a.wait, b.wait ), "same wait times" );
+        assert( same( a.journey, b.journey ), "same journey times" );
+        assert_eq( a.decisions, b.decisions, "same decisions" );
+        assert_eq( a.rounds, b.rounds, "same rounds" );
+    }
+};
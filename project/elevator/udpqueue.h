@@ -2,7 +2,14 @@
 #include <elevator/concurrentqueue.h>
 #include <elevator/restartwrapper.h>
 #include <elevator/serialization.h>
+#include <elevator/poller.h>
 #include <thread>
+#include <vector>
+#include <iterator>
+
+/* QueueSender and QueueReceiver can either run in their own thread (run)
+ * or be attached to Poller, so that many of them share single thread
+ */
 
 #ifndef ELEVATOR_UDP_QUEUE_H
 #define ELEVATOR_UDP_QUEUE_H
@@ -15,16 +22,26 @@ struct QueueSender {
         _sock( bindAddr, true ), _sendAddr( sendAddr ), _queue( queue )
     {
         _sock.enableBroadcast();
+        _batch.reserve( _batchSize );
     }
     void run() {
         _thr = std::thread( restartWrapper( &QueueSender::_runLocal ), this );
     }
 
+    /* must be called before anything is enqueued into queue */
+    void attach( Poller &poller ) {
+        poller.add( _queue.enableNotifyFd(), [this]() { _sendPending(); } );
+    }
+
   private:
     void _runLocal();
+    void _sendPending();
+    void _sendBatch();
+    static const size_t _batchSize = 64;
     udp::Socket _sock;
     udp::Address _sendAddr;
     ConcurrentQueue< T > &_queue;
+    std::vector< T > _batch;
     std::thread _thr;
 };
 
@@ -46,8 +63,14 @@ struct QueueReceiver {
         _thr = std::thread( restartWrapper( &QueueReceiver::_runLocal ), this );
     }
 
+    void attach( Poller &poller ) {
+        poller.add( _sock.fd(), [this]() { _receivePending(); } );
+    }
+
   private:
     void _runLocal();
+    void _receivePending();
+    void _handlePacket( const udp::Packet & );
     udp::Socket _sock;
     ConcurrentQueue< T > &_queue;
     std::thread _thr;
@@ -57,7 +80,25 @@ struct QueueReceiver {
 template< typename T >
 void QueueSender< T >::_runLocal() {
     while ( true ) {
-        auto x = _queue.dequeue();
+        _batch.clear();
+        _queue.timeoutDequeueBatch( std::back_inserter( _batch ), _batchSize, -1 );
+        _sendBatch();
+    }
+}
+
+template< typename T >
+void QueueSender< T >::_sendPending() {
+    _queue.acknowledgeNotify();
+    do {
+        _batch.clear();
+        _queue.dequeueBatch( std::back_inserter( _batch ), _batchSize );
+        _sendBatch();
+    } while ( !_batch.empty() );
+}
+
+template< typename T >
+void QueueSender< T >::_sendBatch() {
+    for ( const auto &x : _batch ) {
         auto pack = serialization::Serializer::toPacket( x );
         pack.address() = _sendAddr;
         _sock.sendPacket( pack );
@@ -66,15 +107,25 @@ void QueueSender< T >::_runLocal() {
 
 template< typename T >
 void QueueReceiver< T >::_runLocal() {
-    while ( true ) {
-        auto pack = _sock.recvPacket();
-        if ( pack.address().ip() == _sock.localAddress().ip() )
-            continue; // ignore local feedback
-        auto mx = serialization::Serializer::fromPacket< T >( pack );
-        assert( !mx.isNothing(), "Received invalid message" );
-        if ( !_pred || _pred( mx.value() ) )
-            _queue.enqueue( mx.value() );
-    }
+    while ( true )
+        _handlePacket( _sock.recvPacket() );
+}
+
+template< typename T >
+void QueueReceiver< T >::_receivePending() {
+    for ( auto pack = _sock.recvPacketNonblocking(); pack.size() > 0;
+            pack = _sock.recvPacketNonblocking() )
+        _handlePacket( pack );
+}
+
+template< typename T >
+void QueueReceiver< T >::_handlePacket( const udp::Packet &pack ) {
+    if ( pack.size() == 0 || pack.address().ip() == _sock.localAddress().ip() )
+        return; // ignore errors and local feedback
+    auto mx = serialization::Serializer::fromPacket< T >( pack );
+    assert( !mx.isNothing(), "Received invalid message" );
+    if ( !_pred || _pred( mx.value() ) )
+        _queue.enqueue( std::move( mx.value() ) );
 }
 
 }
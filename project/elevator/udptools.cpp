@@ -106,18 +106,28 @@ bool Socket::sendPacket( Packet &packet ) {
     return snd == packet.size();
 }
 
-Packet Socket::recvPacket() {
+Packet Socket::_recvPacket( int flags ) {
     sockaddr_in remote;
     socklen_t remlen = sizeof( sockaddr_in );
 
     int rc = recvfrom( _data->fd, _data->rcvbuf.get(), _data->rcvbufsize,
-            0, reinterpret_cast< struct sockaddr * >( &remote ), &remlen );
+            flags, reinterpret_cast< struct sockaddr * >( &remote ), &remlen );
     assert_leq( remlen, sizeof( sockaddr_in ), "Invalid address returned" );
     return rc > 0
         ? Packet( _data->rcvbuf.get(), rc, fromNetAddress( remote ) )
         : Packet();
 }
 
+Packet Socket::recvPacket() {
+    return _recvPacket( 0 );
+}
+
+Packet Socket::recvPacketNonblocking() {
+    return _recvPacket( MSG_DONTWAIT );
+}
+
+int Socket::fd() const { return _data->fd; }
+
 Packet Socket::recvPacketWithTimeout( long ms ) {
     GuardTimout timeout{ _data->fd, ms }; /* sets timeout and resets it when
                                              of exit of this scope (on return) */
@@ -173,7 +173,7 @@ struct Packet {
   private:
     Address _address;
     std::unique_ptr< char[] > _data;
-    int _size;
+    int _size = 0;
 };
 
 enum { standardMTU = 1500 };
@@ -195,6 +195,12 @@ struct Socket {
      * and return Nothing
      */
     Packet recvPacketWithTimeout( long ms );
+    /** receive packet if one is available, otherwise return empty packet
+     * (of size 0) immediatelly */
+    Packet recvPacketNonblocking();
+
+    /** underlying descriptor, for polling */
+    int fd() const;
 
     Address localAddress() const;
 
@@ -208,6 +214,8 @@ struct Socket {
      */
     struct _Data;
     std::unique_ptr< _Data > _data;
+
+    Packet _recvPacket( int flags );
 };
 
 }
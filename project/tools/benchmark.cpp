@@ -0,0 +1,105 @@
+// C++11    (c) 2014 Vladimír Štill <xstill@fi.muni.cz>
+
+/* Scheduler benchmark suite: runs building traffic simulation (see
+ * elevator/trafficsim.h) for selected traffic patterns and dispatch engines
+ * and reports wait and journey times and cost of scheduling decisions
+ */
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <wibble/commandline/parser.h>
+#include <elevator/trafficsim.h>
+#include <elevator/layout.h>
+
+namespace elevator {
+
+using namespace wibble;
+using namespace wibble::commandline;
+
+struct Benchmark {
+    StandardParser opts;
+    IntOption *optCars;
+    IntOption *optFloors;
+    StringOption *optPattern;
+    StringOption *optDispatch;
+    IntOption *optRate;
+    IntOption *optDuration;
+    IntOption *optSeed;
+    IntOption *optStart;
+
+    std::vector< TrafficPattern > patterns{ TrafficPattern::UpPeak, TrafficPattern::DownPeak,
+        TrafficPattern::InterFloor, TrafficPattern::Poisson };
+    std::vector< std::string > engines{ "eta", "distance" };
+    TrafficSimulation::Config config;
+
+    Benchmark( int argc, const char **argv ) : opts( "benchmark", "0.1" ) {
+        OptionGroup *sim = opts.createGroup( "Simulation options" );
+        optCars = sim->add< IntOption >( "cars", 'c', "cars", "N",
+                "number of elevator cars (default 2)" );
+        optFloors = sim->add< IntOption >( "floors", 'f', "floors", "N",
+                "number of floors (default is lab building)" );
+        optPattern = sim->add< StringOption >( "pattern", 'p', "pattern",
+                "up-peak|down-peak|inter-floor|poisson", "run only given traffic pattern" );
+        optDispatch = sim->add< StringOption >( "dispatch", 'd', "dispatch", "eta|distance",
+                "run only given dispatch engine" );
+        optRate = sim->add< IntOption >( "rate", 'r', "rate", "N",
+                "passenger arrivals per hour (default 360)" );
+        optDuration = sim->add< IntOption >( "duration", 't', "duration", "MIN",
+                "simulated minutes of arrivals (default 10)" );
+        optSeed = sim->add< IntOption >( "seed", 's', "seed", "N",
+                "seed of passenger generator (default 1)" );
+        optStart = sim->add< IntOption >( "start", 'S', "start", "HOUR",
+                "time of day at which simulation starts (default 8)" );
+
+        opts.usage = "";
+        opts.description = "Benchmark of elevator scheduling on simulated building, "
+                           "all times are simulated.";
+        opts.add( sim );
+
+        try {
+            opts.parse( argc, argv );
+        } catch ( exception::BadOption &ex ) {
+            std::cerr << "FATAL: " << ex.fullInfo() << std::endl;
+            exit( 1 );
+        }
+        if ( opts.help->boolValue() || opts.version->boolValue() )
+            exit( 0 );
+
+        if ( optFloors->boolValue() )
+            Layout::install( Layout::generate( optFloors->intValue() ) );
+        if ( optCars->boolValue() )
+            config.cars = optCars->intValue();
+        if ( optRate->boolValue() )
+            config.perMinute = optRate->intValue() / 60.0;
+        if ( optDuration->boolValue() )
+            config.duration = optDuration->intValue() * 60 * 1000;
+        if ( optSeed->boolValue() )
+            config.seed = optSeed->intValue();
+        if ( optStart->boolValue() )
+            config.start = optStart->intValue() * 3600 * 1000;
+        if ( optPattern->boolValue() )
+            patterns = { trafficPattern( optPattern->stringValue() ) };
+        if ( optDispatch->boolValue() )
+            engines = { optDispatch->stringValue() };
+    }
+
+    void main() {
+        for ( auto pattern : patterns )
+            for ( const auto &engine : engines ) {
+                config.pattern = pattern;
+                config.dispatch = engine;
+                std::cout << "== " << showPattern( pattern ) << ", " << engine << ", "
+                          << config.cars << " cars, " << config.perMinute * 60
+                          << " passengers/h" << std::endl;
+                TrafficSimulation::run( config ).print( std::cout );
+            }
+    }
+};
+
+}
+
+int main( int argc, const char **argv ) {
+    elevator::Benchmark b( argc, argv );
+    b.main();
+}
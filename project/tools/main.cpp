@@ -11,16 +11,24 @@
 #include <wibble/commandline/parser.h>
 #include <string.h>
 #include <elevator/driver.h>
+#include <elevator/layout.h>
 #include <elevator/test.h>
 #include <elevator/elevator.h>
+#include <elevator/bank.h>
 #include <elevator/scheduler.h>
 #include <elevator/udptools.h>
 #include <elevator/udpqueue.h>
+#include <elevator/poller.h>
 #include <elevator/sessionmanager.h>
 
+static int cars = 1; // number of cars controlled by this process
+
 void handler( int sig, siginfo_t *info, void * ) {
-    elevator::Driver driver;
-    driver.stopElevator();
+    for ( int i = 0; i < cars; ++i ) {
+        elevator::Driver driver{ elevator::Layout::current(),
+            elevator::Bank::deviceName( i ).c_str() };
+        driver.stopElevator();
+    }
     std::cerr << "elevator stopped" << std::endl;
     if ( sig != SIGCHLD ) {
         exit( sig );
@@ -48,11 +56,17 @@ struct Main {
     StandardParser opts;
     OptionGroup *execution;
     IntOption *optNodes;
+    IntOption *optCars;
     BoolOption *avoidRecovery;
+    StringOption *optDispatch;
+    OptionGroup *hardware;
+    StringOption *optLayout;
+    IntOption *optFloors;
     const int peerMsg = 1000;
     std::set< IPv4Address > peerAddresses;
     int id = INT_MIN;
     int nodes = 1;
+    std::string dispatch = "eta";
 
     Main( int argc, const char **argv ) : opts( "elevator", "0.1" ) {
         // setup options
@@ -61,10 +75,28 @@ struct Main {
                 "nodes", 'n', "nodes", "",
                 "specifies number of elevator nodes to expect" );
 
+        optCars = execution->add< IntOption >(
+                "cars", 'c', "cars", "",
+                "number of elevator cars controlled by this node (devices "
+                "/dev/comedi0, /dev/comedi1, ...)" );
+
         avoidRecovery = execution->add< BoolOption >(
                 "avoid recovery", 0, "avoid-recovery", "",
                 "avoid auto-recovery when program is killed (do not fork)" );
 
+        optDispatch = execution->add< StringOption >(
+                "dispatch", 0, "dispatch", "eta|distance",
+                "select elevator for hall calls by estimated time of arrival "
+                "(default) or by distance" );
+
+        hardware = opts.createGroup( "Hardware options" );
+        optLayout = hardware->add< StringOption >(
+                "layout", 0, "layout", "FILE",
+                "load building layout (floors and IO channels) from file" );
+        optFloors = hardware->add< IntOption >(
+                "floors", 0, "floors", "N",
+                "use generated layout with N floors (for simulated hardware)" );
+
         opts.usage = "";
         opts.description = "Elevator control software as a project for the "
                            "TTK4145 Real-Time Programming at NTNU. Controls "
@@ -73,6 +105,7 @@ struct Main {
                            "https://github.com/vlstill/ttk4145/tree/master/project";
 
         opts.add( execution );
+        opts.add( hardware );
 
         // parse options
         try {
@@ -83,6 +116,26 @@ struct Main {
         }
         if ( opts.help->boolValue() || opts.version->boolValue() )
             exit( 0 );
+
+        if ( optCars->boolValue() )
+            cars = optCars->intValue();
+        if ( cars < 1 || ( cars > 1 && optNodes->boolValue() && optNodes->intValue() > 1 ) ) {
+            std::cerr << "FATAL: multiple cars are supported only on single node" << std::endl;
+            exit( 1 );
+        }
+
+        if ( optDispatch->boolValue() )
+            dispatch = optDispatch->stringValue();
+        if ( dispatch != "eta" && dispatch != "distance" ) {
+            std::cerr << "FATAL: unknown dispatch engine " << dispatch << std::endl;
+            exit( 1 );
+        }
+
+        // must be installed before first Driver is created
+        if ( optLayout->boolValue() )
+            Layout::install( Layout::load( optLayout->stringValue() ) );
+        else if ( optFloors->boolValue() )
+            Layout::install( Layout::generate( optFloors->intValue() ) );
     }
 
     void setupChild() {
@@ -145,15 +198,36 @@ struct Main {
             id = 0;
         }
 
-        std::cout << "starting elevator, id " << id << " of " << nodes << " elevators" << std::endl;
+        std::cout << "starting elevator, id " << id << " of " << nodes << " elevators";
+        if ( cars > 1 )
+            std::cout << " (" << cars << " cars)";
+        std::cout << std::endl;
         HeartBeatManager heartbeatManager;
 
-        ConcurrentQueue< Command > commandsToLocalElevator;
-        ConcurrentQueue< Command > commandsToOthers;
-        ConcurrentQueue< StateChange > stateChangesIn;
-        ConcurrentQueue< StateChange > stateChangesOut;
+        /* - command queues of cars are touched by elevator loop on every
+         *   iteration so they are lock-free, they must not lose commands
+         * - command queues of cars have two producers if network receivers
+         *   are running (scheduler and poller), stateChangesIn has producer
+         *   per car and network receiver
+         * - stateChangesIn is bounded and coalesces keep-alives so that
+         *   stalled scheduler does not cause unbounded growth, only
+         *   keep-alives are ever dropped (elevator blocks only if queue is
+         *   full of button and served events)
+         * - the remaining ones are point-to-point between scheduler and
+         *   sender, without sender nobody reads them, so they only keep
+         *   few latest messages
+         */
+        const QueueBackend inBackend = nodes > 1 ? QueueBackend::LockFree : QueueBackend::SPSC;
+        const QueueBackend outBackend = nodes > 1 ? QueueBackend::SPSC : QueueBackend::Locked;
+        const size_t outCapacity = nodes > 1 ? 1024 : 16;
+        const OverflowPolicy outPolicy = nodes > 1 ? OverflowPolicy::Block : OverflowPolicy::DropOldest;
+        ConcurrentQueue< Command > commandsFromOthers{ QueueBackend::SPSC };
+        ConcurrentQueue< Command > commandsToOthers{ outBackend, outCapacity, outPolicy };
+        ConcurrentQueue< StateChange > stateChangesIn{ QueueBackend::Locked, 1024,
+            OverflowPolicy::Coalesce, &StateChange::coalesceKey };
+        ConcurrentQueue< StateChange > stateChangesOut{ outBackend, outCapacity, outPolicy };
 
-        std::unique_ptr< QueueReceiver< Command > > commandsToLocalElevatorReceiver;
+        std::unique_ptr< QueueReceiver< Command > > commandsFromOthersReceiver;
         std::unique_ptr< QueueReceiver< StateChange > > stateChangesInReceiver;
         std::unique_ptr< QueueSender< StateChange > > stateChangesOutSender;
         std::unique_ptr< QueueSender< Command > > commandsToOthersReceiver;
@@ -165,9 +239,9 @@ struct Main {
                     commandsToOthers
                 } );
 
-            commandsToLocalElevatorReceiver.reset( new QueueReceiver< Command >{
+            commandsFromOthersReceiver.reset( new QueueReceiver< Command >{
                     Address{ IPv4Address::any, commandPort },
-                    commandsToLocalElevator,
+                    commandsFromOthers,
                     [id]( const Command &comm ) { return comm.targetElevatorId == id; }
                 } );
 
@@ -195,19 +269,22 @@ struct Main {
          *   all state changes from elevator, but we have to be more carefull here
          *   as it is sleeping sometimes
          */
-        Elevator elevator{ id, heartbeatManager.getNew( 500 /* ms */ ),
-            commandsToLocalElevator, stateChangesIn };
-        Scheduler scheduler{ id, heartbeatManager.getNew( 1000 /* ms */ ),
-            elevator.info(),
-            stateChangesIn, stateChangesOut, commandsToOthers, commandsToLocalElevator };
+        Bank bank{ id * cars, cars, heartbeatManager, stateChangesIn, inBackend };
+        Scheduler scheduler{ heartbeatManager.getNew( 1000 /* ms */ ), bank,
+            stateChangesIn, stateChangesOut, commandsToOthers,
+            DispatchEngine::create( dispatch, bank.info() ) };
 
+        // all network communication is handled by single thread
+        Poller networkPoller;
         if ( nodes > 1 ) {
-            commandsToLocalElevatorReceiver->run();
-            stateChangesInReceiver->run();
-            commandsToOthersReceiver->run();
-            stateChangesOutSender->run();
+            bank.attach( networkPoller, commandsFromOthers );
+            commandsFromOthersReceiver->attach( networkPoller );
+            stateChangesInReceiver->attach( networkPoller );
+            commandsToOthersReceiver->attach( networkPoller );
+            stateChangesOutSender->attach( networkPoller );
+            networkPoller.run();
         }
-        elevator.run();
+        bank.run();
         scheduler.run();
 
         // wait for 2 seconds so that everything has chance to start
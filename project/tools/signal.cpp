@@ -24,6 +24,18 @@ void handler( int sig, siginfo_t *info, void * ) {
 
 void startElevator();
 
+/* run elevator to given floor (blocking), uses busy waiting for sensor */
+void goToFloor( elevator::Driver &driver, int floor ) {
+    int current = driver.getFloor();
+    if ( current == floor )
+        return;
+    driver.setMotorSpeed( current != INT_MIN && current > floor
+            ? elevator::Direction::Down : elevator::Direction::Up, 300 );
+    while ( driver.getFloor() != floor )
+    { }
+    driver.stopElevator();
+}
+
 void setupChild() {
     struct sigaction act;
     memset( &act, 0, sizeof( struct sigaction ) );
@@ -36,9 +48,9 @@ void setupChild() {
     driver.init();
     while ( true ) {
         sleep( 1 );
-        driver.goToFloor( 4 );
+        goToFloor( driver, 4 );
         sleep( 1 );
-        driver.goToFloor( 1 );
+        goToFloor( driver, 1 );
     }
 }
 